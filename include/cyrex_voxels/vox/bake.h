@@ -0,0 +1,122 @@
+//
+// On disk cache of generated worlds and their meshes
+
+#ifndef CYREX_VOXELS_BAKE_H
+#define CYREX_VOXELS_BAKE_H
+
+// bakes are region files, which are only built on unix
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "bakes are POSIX only for now"
+#endif
+
+#include <cyrex_voxels/vox/region.h>
+#include <cstdio>
+
+namespace vox {
+	// Bump whenever generation or meshing changes output for the same parameters,
+	// every existing bake then misses and is rebuilt
+	constexpr std::string_view library_version = "1.0";
+
+	// FNV-1a over everything that decides what a world looks like
+	struct BakeHash {
+		std::uint64_t value{0xcbf29ce484222325ull};
+
+		constexpr BakeHash& add(const std::span<const std::byte> bytes) {
+			for (const std::byte byte : bytes) {
+				value = (value ^ static_cast<std::uint64_t>(byte)) * 0x100000001b3ull;
+			}
+			return *this;
+		}
+
+		BakeHash& add(const std::string_view text) {
+			add(std::as_bytes(std::span(text)));
+			// keeps "ab" + "c" apart from "a" + "bc"
+			return add_value(text.size());
+		}
+
+		// numbers, coordinates, bounds and other plain values; padding bytes would make the hash unstable
+		template<typename T>
+			requires std::has_unique_object_representations_v<T> || std::is_floating_point_v<T>
+		BakeHash& add_value(const T& value) {
+			return add(std::as_bytes(std::span(&value, 1)));
+		}
+
+		BakeHash& add(const Bounds& bounds) {
+			return add_value(bounds.from.x).add_value(bounds.from.y).add_value(bounds.from.z)
+				.add_value(bounds.to.x).add_value(bounds.to.y).add_value(bounds.to.z);
+		}
+	};
+
+	// Key for a world of Voxel over bounds built from params. Params are the inputs of the samplers
+	// (seeds, scales, radii, ...): anything that, when changed, should give a different world.
+	// Voxel only adds its size, type names are not stable across compilers, so name the voxel type
+	// in params when bakes of different types of the same size share a directory.
+	template<typename Voxel>
+	[[nodiscard]] std::uint64_t bake_key(const Bounds& bounds, const auto&... params) {
+		BakeHash hash;
+		hash.add(library_version).add_value(sizeof(Voxel)).add(bounds);
+		const auto add = [&]<typename T>(const T& param) {
+			if constexpr (std::is_convertible_v<const T&, std::string_view>) hash.add(std::string_view(param));
+			else hash.add_value(param);
+		};
+		(add(params), ...);
+		return hash.value;
+	}
+
+	namespace bake_detail {
+		// the directory exists and files can be created in it
+		[[nodiscard]] std::expected<void, RegionError> check_directory(std::string_view directory);
+		[[nodiscard]] std::expected<void, RegionError> save_mesh(std::string_view path, const VoxelMesh& mesh);
+		[[nodiscard]] std::expected<VoxelMesh, RegionError> load_mesh(std::string_view path);
+
+		[[nodiscard]] inline std::string path_for(const std::string_view directory, const std::uint64_t key, const std::string_view extension) {
+			char name[17];
+			std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+			return std::string(directory) + "/" + name + std::string(extension);
+		}
+	}
+
+	template<typename Voxel, int Size = default_chunk_size>
+	struct Baked {
+		RegionFile<Voxel, Size> voxels;
+		VoxelMesh mesh;
+		// false when this call generated and stored it
+		bool hit{};
+	};
+
+	// Loads the voxels and mesh stored under key in directory. On a miss, or when the stored files
+	// cannot be read, generate() builds the world (any sampler), mesh(sampler) meshes it, and both are
+	// written back for next time. The directory must exist and be writable; that is checked before
+	// anything is generated, so a caller falling back to generating without the bake does not pay twice.
+	// threads is passed to save_region, only pass more than 1 when the generated sampler is safe to
+	// call from several threads at once.
+	template<int ChunkSize = default_chunk_size, typename Generate, typename Mesh>
+	[[nodiscard]] auto bake(const std::string_view directory, const std::uint64_t key, const Bounds& bounds,
+		const Generate generate, const Mesh mesh, const unsigned threads = 1)
+		-> std::expected<Baked<std::invoke_result_t<std::invoke_result_t<Generate>, Coord>, ChunkSize>, RegionError> {
+		using Voxel = std::invoke_result_t<std::invoke_result_t<Generate>, Coord>;
+		const std::string voxels_path = bake_detail::path_for(directory, key, ".region");
+		const std::string mesh_path = bake_detail::path_for(directory, key, ".mesh");
+
+		{
+			auto voxels = open_region<Voxel, ChunkSize>(voxels_path);
+			auto stored = bake_detail::load_mesh(mesh_path);
+			if (voxels && stored) return Baked<Voxel, ChunkSize>{std::move(*voxels), std::move(*stored), true};
+		}
+
+		if (auto usable = bake_detail::check_directory(directory); !usable) return std::unexpected(usable.error());
+
+		const auto sampler = generate();
+		VoxelMesh meshed = mesh(sampler);
+
+		if (auto saved = save_region<ChunkSize>(voxels_path, sampler, bounds, threads); !saved) return std::unexpected(saved.error());
+		// the mesh goes last, a bake only counts once it exists
+		if (auto saved = bake_detail::save_mesh(mesh_path, meshed); !saved) return std::unexpected(saved.error());
+
+		auto voxels = open_region<Voxel, ChunkSize>(voxels_path);
+		if (!voxels) return std::unexpected(voxels.error());
+		return Baked<Voxel, ChunkSize>{std::move(*voxels), std::move(meshed), false};
+	}
+}
+
+#endif //CYREX_VOXELS_BAKE_H
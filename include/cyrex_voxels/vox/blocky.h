@@ -8,19 +8,15 @@
 #include <array>
 #include <chrono>
 #include <cyrex_voxels/vox/voxel.h>
+#include <cyrex_voxels/vox/pyramid.h>
 
 namespace vox {
     namespace blocky_detail {
         extern const std::array<VoxelMesh, 64> lookup_table;
-    }
-
-    template<VoxelSampler Sampler>
-    [[nodiscard]] auto make_blocky_mesher(const Sampler& sampler) {
-        return [&sampler](const Bounds& bounds) -> VoxelMesh {
-            VoxelMesh mesh{};
-            mesh.vertices.reserve(0xFFFF);
-            mesh.indices.reserve(0xFFFF);
 
+        // Emits the faces of every visible voxel of region, neighbours outside bounds count as empty
+        template<VoxelSampler Sampler>
+        void mesh_region(const Sampler& sampler, const Bounds& bounds, const Bounds& region, VoxelMesh& mesh) {
             constexpr glm::ivec3 Up {0, 1, 0};
             constexpr glm::ivec3 Down {0, -1, 0};
             constexpr glm::ivec3 Left {-1, 0, 0};
@@ -28,7 +24,7 @@ namespace vox {
             constexpr glm::ivec3 Front {0, 0, 1};
             constexpr glm::ivec3 Back {0, 0, -1};
 
-            sample_each(bounds, sampler, [&]<typename Voxel>(const Coord p, const Voxel voxel) {
+            sample_each(region, sampler, [&]<typename Voxel>(const Coord p, const Voxel voxel) {
                 using traits = voxel_mesh_traits<Voxel>;
                 if (!traits::is_visible(voxel)) return;
 
@@ -52,7 +48,7 @@ namespace vox {
 
 
                 const auto num_vertices = mesh.vertices.size();
-                const auto& lookup = blocky_detail::lookup_table.at(mask);
+                const auto& lookup = lookup_table.at(mask);
 
                 // Transform vertex (shift and apply coloring)
                 for (const auto& vertex : lookup.vertices) {
@@ -66,6 +62,46 @@ namespace vox {
                     mesh.indices.emplace_back(indice + num_vertices);
                 }
             });
+        }
+    }
+
+    template<VoxelSampler Sampler>
+    [[nodiscard]] auto make_blocky_mesher(const Sampler& sampler) {
+        return [&sampler](const Bounds& bounds) -> VoxelMesh {
+            VoxelMesh mesh{};
+            mesh.vertices.reserve(0xFFFF);
+            mesh.indices.reserve(0xFFFF);
+
+            // only voxels inside the support can be visible, and only visible voxels have faces
+            const Bounds region = clip_to_support(bounds, sampler);
+            if (!support_detail::is_empty(region)) blocky_detail::mesh_region(sampler, bounds, region, mesh);
+
+            return mesh;
+        };
+    }
+
+    // Same output, but blocks the pyramid proves empty, or solid with a solid border, are skipped
+    template<VoxelSampler Sampler>
+    [[nodiscard]] auto make_blocky_mesher(const Sampler& sampler, const OccupancyPyramid& pyramid) {
+        return [&sampler, &pyramid](const Bounds& bounds) -> VoxelMesh {
+            VoxelMesh mesh{};
+            mesh.vertices.reserve(0xFFFF);
+            mesh.indices.reserve(0xFFFF);
+
+            const int block_size = pyramid.levels.front().block_size;
+            each({Coord(0), (bounds.size() - Coord(1)) / block_size}, [&](const Coord block) {
+                const Coord from = bounds.from + block * block_size;
+                const Bounds region{from, glm::min(from + Coord(block_size - 1), bounds.to)};
+
+                if (pyramid.classify(region) == Region::Empty) return;
+
+                // faces appear where a solid voxel touches air or the edge of the bounds
+                const Bounds border{region.from - Coord(1), region.to + Coord(1)};
+                const bool inside = bounds.contains(border.from) && bounds.contains(border.to);
+                if (inside && pyramid.classify(border) == Region::Full) return;
+
+                blocky_detail::mesh_region(sampler, bounds, region, mesh);
+            });
 
             return mesh;
         };
@@ -0,0 +1,181 @@
+//
+// Chunk cache that stays under a memory budget
+
+#ifndef CYREX_VOXELS_BUDGET_H
+#define CYREX_VOXELS_BUDGET_H
+
+#include <cyrex_voxels/vox/chunk.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+
+namespace vox {
+	enum class Eviction {
+		LeastRecentlyUsed,
+		// drops the chunks farthest from the focus first, e.g. rend::FirstPersonCamera::eye
+		FarthestFromFocus
+	};
+
+	// Chunks are sampled on first touch and dropped again once the cache holds more than budget bytes.
+	// An evicted chunk is simply sampled again the next time it is touched, so the source can be
+	// a generator or anything else that reads like a sampler, such as a region file.
+	// Going over budget evicts down to 7/8 of it in one go, so a sweep over new ground does not
+	// pay for a sort on every miss. Hits take a shared lock, misses and evictions an exclusive one.
+	template<int ChunkSize = default_chunk_size, VoxelSampler Sampler>
+	auto budget_cache(const Sampler& sampler, const Bounds bounds, const std::size_t budget,
+		const Eviction eviction = Eviction::LeastRecentlyUsed) {
+		using Voxel = std::invoke_result_t<Sampler, Coord>;
+		static_assert(std::equality_comparable<Voxel>, "budget_cache needs comparable voxels to collapse chunks");
+
+		struct Cache {
+			using Chunk = vox::Chunk<Voxel, ChunkSize>;
+
+			struct Stats {
+				std::uint64_t hits{};
+				std::uint64_t misses{};
+				std::uint64_t evictions{};
+				std::size_t bytes{};
+				std::size_t chunks{};
+			};
+
+			// written by hits under the shared lock; each chunk has its own counters, so threads working
+			// on different chunks do not write to the same cache line
+			struct Entry {
+				Chunk chunk;
+				std::atomic<std::uint64_t> used{};
+				std::atomic<std::uint64_t> hits{};
+			};
+
+			// everything lookups mutate, shared so the cache stays copyable (the meshers take samplers
+			// by value) and copies fill, evict and count against the same budget
+			struct State {
+				std::unordered_map<Coord, Entry, CoordHash> chunks;
+				std::shared_mutex lock;
+				std::size_t bytes{};
+				glm::vec3 focus{};
+				// ticks once per miss, under the exclusive lock. Evictions only happen on a miss, so
+				// recency finer than that would not change what gets evicted
+				std::atomic<std::uint64_t> clock{0};
+				// hits of chunks that have been evicted, the rest are counted in their entries
+				std::atomic<std::uint64_t> hits{0};
+				std::atomic<std::uint64_t> misses{0};
+				std::atomic<std::uint64_t> evictions{0};
+			};
+
+			Sampler sampler;
+			Bounds bounds;
+			std::size_t budget;
+			Eviction eviction;
+			std::shared_ptr<State> state;
+
+			[[nodiscard]] Voxel operator ()(const Coord coord) const {
+				if (!bounds.contains(coord)) return Voxel{};
+				const Coord chunk = chunk_coord<ChunkSize>(coord);
+				const Coord local = chunk_local<ChunkSize>(coord);
+
+				{
+					const std::shared_lock lock(state->lock);
+					if (const auto it = state->chunks.find(chunk); it != state->chunks.end()) {
+						Entry& entry = it->second;
+						entry.hits.fetch_add(1, std::memory_order_relaxed);
+						// only the first hit since the last miss writes the stamp
+						const std::uint64_t now = state->clock.load(std::memory_order_relaxed);
+						if (entry.used.load(std::memory_order_relaxed) != now) entry.used.store(now, std::memory_order_relaxed);
+						return entry.chunk[local];
+					}
+				}
+
+				// sample without holding the lock, another thread may get there first
+				state->misses.fetch_add(1, std::memory_order_relaxed);
+				Chunk sampled = Chunk::sample(sampler, chunk, bounds);
+				const Voxel voxel = sampled[local];
+
+				const std::scoped_lock lock(state->lock);
+				if (const auto [it, inserted] = state->chunks.try_emplace(chunk); inserted) {
+					it->second.chunk = std::move(sampled);
+					it->second.used.store(state->clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+					state->bytes += entry_bytes(it->second.chunk);
+					if (state->bytes > budget) evict(chunk);
+				}
+				return voxel;
+			}
+
+			[[nodiscard]] std::optional<Bounds> support() const {
+				return support_detail::intersect(bounds, vox::support(sampler));
+			}
+
+			// Where FarthestFromFocus measures from, call whenever the camera moves
+			void focus(const glm::vec3 position) {
+				const std::scoped_lock lock(state->lock);
+				state->focus = position;
+			}
+
+			[[nodiscard]] Stats stats() const {
+				const std::shared_lock lock(state->lock);
+				Stats stats{
+					.hits = state->hits.load(std::memory_order_relaxed),
+					.misses = state->misses.load(std::memory_order_relaxed),
+					.evictions = state->evictions.load(std::memory_order_relaxed),
+					.bytes = state->bytes,
+					.chunks = state->chunks.size()
+				};
+				for (const auto& [_, entry] : state->chunks) {
+					stats.hits += entry.hits.load(std::memory_order_relaxed);
+				}
+				return stats;
+			}
+
+			explicit Cache(const Sampler& sampler, const Bounds& bounds, const std::size_t budget, const Eviction eviction) :
+				sampler(sampler),
+				bounds(bounds),
+				budget(budget),
+				eviction(eviction),
+				state(std::make_shared<State>()) {}
+
+		private:
+			[[nodiscard]] static std::size_t entry_bytes(const Chunk& chunk) {
+				// the chunk itself plus roughly what the hash map spends on the node
+				return chunk.bytes() + sizeof(Entry) + sizeof(Coord) + 2 * sizeof(void*);
+			}
+
+			// exclusive lock held, keep is the chunk just inserted and is never dropped
+			void evict(const Coord keep) const {
+				const auto priority = [&](const auto& entry) -> double {
+					if (eviction == Eviction::LeastRecentlyUsed) {
+						return static_cast<double>(entry.second.used.load(std::memory_order_relaxed));
+					}
+					const glm::vec3 centre = glm::vec3(entry.first * ChunkSize) + glm::vec3(ChunkSize * 0.5f);
+					const glm::vec3 offset = centre - state->focus;
+					return -static_cast<double>(glm::dot(offset, offset));
+				};
+
+				// lowest priority goes first
+				std::vector<std::pair<double, Coord>> order;
+				order.reserve(state->chunks.size());
+				for (const auto& entry : state->chunks) {
+					order.emplace_back(priority(entry), entry.first);
+				}
+				std::ranges::sort(order, {}, &std::pair<double, Coord>::first);
+
+				const std::size_t target = budget - budget / 8;
+				for (const auto& [_, coord] : order) {
+					if (state->bytes <= target) break;
+					if (coord == keep) continue;
+					const auto it = state->chunks.find(coord);
+					state->hits.fetch_add(it->second.hits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+					state->bytes -= entry_bytes(it->second.chunk);
+					state->chunks.erase(it);
+					state->evictions.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+		};
+
+		return Cache(sampler, bounds, budget, eviction);
+	}
+}
+
+#endif //CYREX_VOXELS_BUDGET_H
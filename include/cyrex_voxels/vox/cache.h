@@ -6,17 +6,111 @@
 #define CYREX_VOXELS_CACHE_H
 
 #include <cyrex_voxels/vox/voxel.h>
+#include <cyrex_voxels/vox/parallel.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
 
 namespace vox {
-	template <VoxelSampler Sampler>
-	constexpr auto flat_cache(const Sampler& sampler, const Bounds bounds) {
+	// Memory layouts for flat_cache, each maps a local (non negative) coordinate to an index
+	namespace layout {
+		// x-major rows, neighbours along y and z are a row or a slice apart
+		struct Linear {
+			Coord size;
+
+			constexpr explicit Linear(const Coord size) : size(size) {}
+
+			[[nodiscard]] constexpr std::size_t volume() const noexcept {
+				return static_cast<std::size_t>(size.x) * size.y * size.z;
+			}
+
+			[[nodiscard]] constexpr std::size_t index(const Coord local) const noexcept {
+				return local.x + static_cast<std::size_t>(size.x) * (local.y + static_cast<std::size_t>(size.y) * local.z);
+			}
+		};
+
+		// x-major inside a Size^3 brick
+		template<int Size>
+		struct brick_order {
+			[[nodiscard]] static constexpr std::size_t index(const Coord local) noexcept {
+				return local.x + Size * (local.y + Size * local.z);
+			}
+		};
+
+		// z-order curve inside a Size^3 brick, Size must be a power of two up to 1024
+		template<int Size>
+		struct morton_order {
+			static_assert((Size & (Size - 1)) == 0 && Size <= 1024);
+
+			[[nodiscard]] static constexpr std::uint32_t spread(std::uint32_t v) noexcept {
+				v = (v | (v << 16)) & 0x030000FF;
+				v = (v | (v << 8)) & 0x0300F00F;
+				v = (v | (v << 4)) & 0x030C30C3;
+				v = (v | (v << 2)) & 0x09249249;
+				return v;
+			}
+
+			[[nodiscard]] static constexpr std::size_t index(const Coord local) noexcept {
+				return spread(local.x) | (spread(local.y) << 1) | (spread(local.z) << 2);
+			}
+		};
+
+		// Splits the volume into Size^3 bricks laid out x-major, Order arranges voxels inside a brick.
+		// Bounds are padded up to whole bricks.
+		template<int Size, typename Order>
+		struct Tiled {
+			static_assert((Size & (Size - 1)) == 0, "brick size must be a power of two");
+			static constexpr std::size_t brick_volume = static_cast<std::size_t>(Size) * Size * Size;
+			Coord bricks;
+
+			constexpr explicit Tiled(const Coord size) : bricks((size + Coord(Size - 1)) / Size) {}
+
+			[[nodiscard]] constexpr std::size_t volume() const noexcept {
+				return static_cast<std::size_t>(bricks.x) * bricks.y * bricks.z * brick_volume;
+			}
+
+			[[nodiscard]] constexpr std::size_t index(const Coord local) const noexcept {
+				// local is never negative, unsigned maths turns the divisions into shifts
+				constexpr std::uint32_t mask = Size - 1;
+				const std::uint32_t x = local.x, y = local.y, z = local.z;
+				const std::size_t brick_index =
+					x / Size + static_cast<std::size_t>(bricks.x) * (y / Size + static_cast<std::size_t>(bricks.y) * (z / Size));
+				return brick_index * brick_volume + Order::index(Coord(x & mask, y & mask, z & mask));
+			}
+		};
+
+		// 4^3 bricks of ints are exactly 4 cache lines, 8^3 bricks fit a page
+		template<int Size>
+		using Bricked = Tiled<Size, brick_order<Size>>;
+
+		// A single global z-order curve over non cubic bounds would pad to the largest power of two cube,
+		// so the curve runs inside power of two tiles instead
+		template<int Size = 16>
+		using Morton = Tiled<Size, morton_order<Size>>;
+	}
+
+	// Sampled up front a row at a time. Every voxel is written exactly once from the sampler, so the
+	// result does not depend on the thread count.
+	// Only the sampler's support is sampled, the rest of the bounds is left empty.
+	// threads > 1 spreads the z slices across threads and calls the sampler concurrently, only pass
+	// it for samplers that are safe to call from several threads at once (default_thread_count()).
+	template <typename Layout = layout::Linear, VoxelSampler Sampler>
+	constexpr auto flat_cache(const Sampler& sampler, const Bounds bounds, const unsigned threads = 1) {
 		using Voxel = std::invoke_result_t<Sampler, Coord>;
 
 		struct Cache {
 			std::vector<Voxel> voxels;
 			Bounds bounds;
-			int width{};
-			int height{};
+			Layout layout;
+			// the part of the bounds the sampler could fill, nothing else was sampled
+			Bounds occupied;
 
 			[[nodiscard]] constexpr Voxel operator ()(const Coord coord) const {
 				if  (!bounds.contains(coord)) return Voxel{};
@@ -26,27 +120,165 @@ namespace vox {
 					coord.y - bounds.from.y,
 					coord.z - bounds.from.z
 				};
-				const int index = local.x + width * (local.y + height * local.z);
-				return voxels[index];
-			}
-
-			explicit Cache(const Sampler& sampler, const Bounds& bounds) : bounds(bounds) {
-				const auto size = bounds.size();
-				width = size.x;
-				height = size.y;
-				const std::size_t volume = size.x * size.y * size.z;
-				voxels.resize(volume);
-				each(bounds, [&, index = 0](const Coord coord) mutable {
-					voxels[index++] = sampler(coord);
-				});
+				return voxels[layout.index(local)];
+			}
+
+			[[nodiscard]] constexpr std::optional<Bounds> support() const {
+				return occupied;
+			}
+
+			explicit Cache(const Sampler& sampler, const Bounds& bounds, const unsigned threads) :
+				bounds(bounds), layout(bounds.size()), occupied(clip_to_support(bounds, sampler)) {
+				voxels.resize(layout.volume());
+				if (support_detail::is_empty(occupied)) return;
+
+				// std::vector<bool> packs neighbours into shared words, so it cannot be written concurrently
+				constexpr bool packed = std::is_same_v<Voxel, bool>;
+				const unsigned workers = packed ? 1u : threads;
+				const int width = occupied.size().x;
+				const int rows = hoists_slices<Sampler> ? occupied.size().y : 1;
+				// linear rows are contiguous, and so are whole slices when the occupied part spans the bounds'
+				// width, so those are sampled in place; anything else goes through one buffer per worker
+				constexpr bool linear = std::is_same_v<Layout, layout::Linear> && !packed;
+				const bool in_place = linear && (rows == 1 || width == bounds.size().x);
+				const std::size_t area = static_cast<std::size_t>(width) * rows;
+				parallel_for_with(occupied.size().z, [&] {
+					return in_place ? nullptr : std::make_unique<Voxel[]>(area);
+				}, [&](const std::size_t z, const std::unique_ptr<Voxel[]>& buffer) {
+					const int slice = occupied.from.z + static_cast<int>(z);
+					for (int y = occupied.from.y; y <= occupied.to.y; y += rows) {
+						const Coord start(occupied.from.x, y, slice);
+						if constexpr (linear) {
+							if (in_place) {
+								sample_slice(sampler, start, width, std::span(voxels).subspan(layout.index(start - bounds.from), area));
+								continue;
+							}
+						}
+
+						sample_slice(sampler, start, width, std::span(buffer.get(), area));
+						for (int j = 0; j < rows; ++j) {
+							const Voxel* row = buffer.get() + static_cast<std::size_t>(width) * j;
+							if constexpr (std::is_same_v<Layout, layout::Linear>) {
+								std::copy(row, row + width, voxels.begin() + layout.index(start + Coord(0, j, 0) - bounds.from));
+							} else {
+								for (int x = 0; x < width; ++x) {
+									voxels[layout.index(start + Coord(x, j, 0) - bounds.from)] = row[x];
+								}
+							}
+						}
+					}
+				}, workers);
 			}
 		};
 
-		return Cache(sampler, bounds);
+		return Cache(sampler, bounds, threads);
 	}
 
-	// to do: octrees
+	// Like flat_cache, but the bounds are split into BrickSize^3 bricks that are only sampled
+	// the first time a lookup touches them. Safe to read from many threads at once: a brick is
+	// filled under a striped lock and published with a release store, so the hot path is a single
+	// acquire load once a brick exists. Copies share their bricks.
+	template <int BrickSize = 16, VoxelSampler Sampler>
+	constexpr auto lazy_cache(const Sampler& sampler, const Bounds bounds) {
+		using Voxel = std::invoke_result_t<Sampler, Coord>;
+		static_assert((BrickSize & (BrickSize - 1)) == 0, "brick size must be a power of two");
+
+		struct Cache {
+			struct Brick {
+				std::atomic<bool> ready{false};
+				std::unique_ptr<Voxel[]> voxels;
+			};
+
+			Sampler sampler;
+			Bounds bounds;
+			// the part of the bounds the sampler could fill, lookups anywhere else never touch a brick
+			Bounds occupied;
+			Coord bricks;
+			struct State {
+				std::unique_ptr<Brick[]> bricks;
+				// fills are rare, a few striped locks are plenty
+				std::array<std::mutex, 64> locks;
+			};
+
+			// shared, so copies of the cache (the meshers take samplers by value) fill and read the same bricks
+			std::shared_ptr<State> state;
+
+			[[nodiscard]] Voxel operator ()(const Coord coord) const {
+				if (!occupied.contains(coord)) return Voxel{};
+				const std::uint32_t x = coord.x - bounds.from.x;
+				const std::uint32_t y = coord.y - bounds.from.y;
+				const std::uint32_t z = coord.z - bounds.from.z;
+
+				const Brick& brick = touch(x / BrickSize + bricks.x * (y / BrickSize + bricks.y * (z / BrickSize)));
+				constexpr std::uint32_t mask = BrickSize - 1;
+				return brick.voxels[(x & mask) + BrickSize * ((y & mask) + BrickSize * (z & mask))];
+			}
+
+			// Fills every brick overlapping the region up front, spread across threads
+			void warm(const Bounds& region, const unsigned threads = default_thread_count()) const {
+				const Coord from = (glm::max(region.from, occupied.from) - bounds.from) / BrickSize;
+				const Coord to = (glm::min(region.to, occupied.to) - bounds.from) / BrickSize;
+				if (from.x > to.x || from.y > to.y || from.z > to.z) return;
+
+				const Coord span = to - from + Coord(1);
+				parallel_for(static_cast<std::size_t>(span.x) * span.y * span.z, [&](const std::size_t i) {
+					const Coord brick = from + Coord(i % span.x, (i / span.x) % span.y, i / (span.x * span.y));
+					touch(brick.x + bricks.x * (brick.y + bricks.y * brick.z));
+				}, threads);
+			}
+
+			[[nodiscard]] constexpr std::optional<Bounds> support() const {
+				return occupied;
+			}
 
+			[[nodiscard]] std::size_t filled_bricks() const noexcept {
+				std::size_t filled = 0;
+				for (std::size_t i = 0; i < brick_count(); ++i) {
+					filled += state->bricks[i].ready.load(std::memory_order_relaxed);
+				}
+				return filled;
+			}
+
+			[[nodiscard]] std::size_t brick_count() const noexcept {
+				return static_cast<std::size_t>(bricks.x) * bricks.y * bricks.z;
+			}
+
+			explicit Cache(const Sampler& sampler, const Bounds& bounds) :
+				sampler(sampler),
+				bounds(bounds),
+				occupied(clip_to_support(bounds, sampler)),
+				bricks((bounds.size() + Coord(BrickSize - 1)) / BrickSize),
+				state(std::make_shared<State>(std::make_unique<Brick[]>(brick_count()))) {}
+
+		private:
+			const Brick& touch(const std::size_t index) const {
+				Brick& brick = state->bricks[index];
+				if (brick.ready.load(std::memory_order_acquire)) return brick;
+
+				const std::scoped_lock lock(state->locks[index % state->locks.size()]);
+				if (brick.ready.load(std::memory_order_relaxed)) return brick;
+
+				const Coord brick_coord(
+					index % bricks.x,
+					(index / bricks.x) % bricks.y,
+					index / (static_cast<std::size_t>(bricks.x) * bricks.y));
+				const Coord origin = bounds.from + brick_coord * BrickSize;
+
+				auto voxels = std::make_unique<Voxel[]>(BrickSize * BrickSize * BrickSize);
+				each({origin, origin + Coord(BrickSize - 1)}, [&, i = 0](const Coord coord) mutable {
+					// the last brick on each axis hangs over the bounds
+					if (occupied.contains(coord)) voxels[i] = sampler(coord);
+					++i;
+				});
+
+				brick.voxels = std::move(voxels);
+				brick.ready.store(true, std::memory_order_release);
+				return brick;
+			}
+		};
+
+		return Cache(sampler, bounds);
+	}
 }
 
-#endif //CYREX_VOXELS_CACHE_H
\ No newline at end of file
+#endif //CYREX_VOXELS_CACHE_H
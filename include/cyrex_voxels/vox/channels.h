@@ -0,0 +1,90 @@
+//
+// Struct of arrays cache for several fields over the same bounds
+
+#ifndef CYREX_VOXELS_CHANNELS_H
+#define CYREX_VOXELS_CHANNELS_H
+
+#include <cyrex_voxels/vox/cache.h>
+#include <tuple>
+#include <utility>
+
+namespace vox {
+	template<typename... Voxels>
+	struct ChannelCache;
+
+	namespace channels_detail {
+		template<typename Tuple>
+		struct cache_for;
+
+		template<typename... Voxels>
+		struct cache_for<std::tuple<Voxels...>> {
+			using type = ChannelCache<Voxels...>;
+		};
+	}
+
+	// An invokable object that returns a tuple of voxels, one per channel
+	// Usage: sampler(Coord) -> std::tuple<Voxel...>
+	template<typename Sampler>
+	concept ChannelSampler = requires {
+		typename channels_detail::cache_for<std::invoke_result_t<Sampler, Coord>>::type;
+	};
+
+	// One array per channel, all filled by a single traversal of the bounds
+	template<typename... Voxels>
+	struct ChannelCache {
+		std::tuple<std::vector<Voxels>...> channels;
+		Bounds bounds;
+		layout::Linear layout;
+
+		// A read only sampler over one channel, holds a pointer so the cache must outlive it
+		template<std::size_t I>
+		struct View {
+			using Voxel = std::tuple_element_t<I, std::tuple<Voxels...>>;
+			const ChannelCache* cache;
+
+			[[nodiscard]] constexpr Voxel operator ()(const Coord coord) const {
+				if (!cache->bounds.contains(coord)) return Voxel{};
+				return std::get<I>(cache->channels)[cache->layout.index(coord - cache->bounds.from)];
+			}
+		};
+
+		template<std::size_t I>
+		[[nodiscard]] constexpr View<I> channel() const noexcept {
+			return {this};
+		}
+
+		template<ChannelSampler Sampler>
+		explicit ChannelCache(const Sampler& sampler, const Bounds& bounds) : bounds(bounds), layout(bounds.size()) {
+			std::apply([&](auto&... channel) {
+				(channel.resize(layout.volume()), ...);
+			}, channels);
+
+			each(bounds, [&, index = std::size_t{0}](const Coord coord) mutable {
+				const auto voxels = sampler(coord);
+				[&]<std::size_t... I>(std::index_sequence<I...>) {
+					((std::get<I>(channels)[index] = std::get<I>(voxels)), ...);
+				}(std::index_sequence_for<Voxels...>{});
+				++index;
+			});
+		}
+	};
+
+	// Caches a sampler that returns a tuple, one channel per element.
+	// Work shared between channels (a heightmap lookup, a noise call) runs once per coordinate.
+	template<ChannelSampler Sampler>
+	constexpr auto fused_channel_cache(const Sampler& sampler, const Bounds bounds) {
+		using Cache = typename channels_detail::cache_for<std::invoke_result_t<Sampler, Coord>>::type;
+		return Cache(sampler, bounds);
+	}
+
+	// Caches several samplers in one pass, use channel<I>() to read them back
+	template<VoxelSampler... Samplers>
+	constexpr auto channel_cache(const Bounds bounds, const Samplers&... samplers) {
+		static_assert(sizeof...(Samplers) > 0);
+		return fused_channel_cache([&](const Coord coord) {
+			return std::tuple{samplers(coord)...};
+		}, bounds);
+	}
+}
+
+#endif //CYREX_VOXELS_CHANNELS_H
@@ -0,0 +1,176 @@
+//
+// Sparse chunked storage
+
+#ifndef CYREX_VOXELS_CHUNK_H
+#define CYREX_VOXELS_CHUNK_H
+
+#include <cyrex_voxels/vox/voxel.h>
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+
+namespace vox {
+	constexpr int default_chunk_size = 32;
+
+	struct CoordHash {
+		[[nodiscard]] constexpr std::size_t operator()(const Coord coord) const noexcept {
+			// large primes, cheap and good enough for chunk keys
+			return static_cast<std::size_t>(coord.x) * 73856093u ^
+				   static_cast<std::size_t>(coord.y) * 19349663u ^
+				   static_cast<std::size_t>(coord.z) * 83492791u;
+		}
+	};
+
+	// floors towards negative infinity so negative coordinates land in the right chunk
+	[[nodiscard]] constexpr int floor_div(const int value, const int divisor) {
+		const int quotient = value / divisor;
+		return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? quotient - 1 : quotient;
+	}
+
+	template<int Size>
+	[[nodiscard]] constexpr Coord chunk_coord(const Coord coord) {
+		return {floor_div(coord.x, Size), floor_div(coord.y, Size), floor_div(coord.z, Size)};
+	}
+
+	template<int Size>
+	[[nodiscard]] constexpr Coord chunk_local(const Coord coord) {
+		return coord - chunk_coord<Size>(coord) * Size;
+	}
+
+	template<int Size>
+	[[nodiscard]] constexpr int chunk_index(const Coord local) {
+		return local.x + Size * (local.y + Size * local.z);
+	}
+
+	template<int Size>
+	[[nodiscard]] constexpr Bounds chunk_bounds(const Coord chunk) {
+		const Coord from = chunk * Size;
+		return {.from = from, .to = from + Coord(Size - 1)};
+	}
+
+	// Calls fn(chunk) for every chunk overlapping the bounds
+	template<int Size>
+	constexpr void each_chunk(const Bounds& bounds, auto fn) {
+		const Coord from = chunk_coord<Size>(bounds.from);
+		const Coord to = chunk_coord<Size>(bounds.to);
+		each({from, to}, fn);
+	}
+
+	// A cube of voxels that collapses to a single value when every voxel is the same
+	template<typename Voxel, int Size>
+	struct Chunk {
+		static constexpr int size = Size;
+		static constexpr int volume = Size * Size * Size;
+
+		Voxel uniform{};
+		std::vector<Voxel> voxels;
+
+		[[nodiscard]] constexpr bool is_uniform() const noexcept {
+			return voxels.empty();
+		}
+
+		[[nodiscard]] constexpr Voxel operator[](const Coord local) const {
+			if (is_uniform()) return uniform;
+			return voxels[chunk_index<Size>(local)];
+		}
+
+		// drops the voxel array if every voxel turned out to be the same
+		constexpr void collapse() {
+			if (is_uniform()) return;
+			const Voxel first = voxels.front();
+			for (const auto& voxel : voxels) {
+				if (!(voxel == first)) return;
+			}
+			uniform = first;
+			voxels = {};
+		}
+
+		[[nodiscard]] constexpr std::size_t bytes() const noexcept {
+			return sizeof(Chunk) + voxels.capacity() * sizeof(Voxel);
+		}
+
+		// samples every voxel of the chunk a row or slice at a time, voxels outside the clip bounds or the
+		// sampler's support are left empty
+		template<VoxelSampler Sampler>
+		[[nodiscard]] static Chunk sample(const Sampler& sampler, const Coord chunk, const Bounds& bounds) {
+			const Bounds box = chunk_bounds<Size>(chunk);
+			const Bounds inside = *support_detail::intersect(box, clip_to_support(bounds, sampler));
+			Chunk result;
+			if (support_detail::is_empty(inside)) return result;
+			result.voxels.resize(volume);
+
+			// samplers that share work between rows get as many rows of the chunk per call as the buffer holds
+			const Coord size = inside.size();
+			std::array<Voxel, hoists_slices<Sampler> ? std::min<std::size_t>(slice_block, Size * Size) : Size> buffer;
+			for (int z = inside.from.z; z <= inside.to.z; ++z) {
+				each_slice_piece(Coord(inside.from.x, inside.from.y, z), size.x, size.y, buffer.size(),
+					[&](std::size_t, const Coord start, const int width, const int rows) {
+						const std::span<Voxel> clipped = std::span(buffer).first(static_cast<std::size_t>(width) * rows);
+						sample_slice(sampler, start, width, clipped);
+						for (int j = 0; j < rows; ++j) {
+							const auto row = clipped.begin() + static_cast<std::ptrdiff_t>(width) * j;
+							std::copy(row, row + width, result.voxels.begin() + chunk_index<Size>(start + Coord(0, j, 0) - box.from));
+						}
+					});
+			}
+			result.collapse();
+			return result;
+		}
+	};
+
+	// Materialises a sampler into fixed size chunks held in a hash map.
+	// Chunks that are entirely empty are not stored and uniform chunks are kept as a single voxel,
+	// so memory follows surface complexity rather than the volume of the bounds.
+	template<int ChunkSize = default_chunk_size, VoxelSampler Sampler>
+	auto chunked_cache(const Sampler& sampler, const Bounds bounds) {
+		using Voxel = std::invoke_result_t<Sampler, Coord>;
+		static_assert(std::equality_comparable<Voxel>, "chunked_cache needs comparable voxels to collapse chunks");
+
+		struct Cache {
+			using Chunk = vox::Chunk<Voxel, ChunkSize>;
+
+			std::unordered_map<Coord, Chunk, CoordHash> chunks;
+			Bounds bounds;
+			// the part of the bounds the sampler could fill, only chunks overlapping it were sampled
+			Bounds occupied;
+
+			[[nodiscard]] Voxel operator ()(const Coord coord) const {
+				if (!bounds.contains(coord)) return Voxel{};
+				const auto it = chunks.find(chunk_coord<ChunkSize>(coord));
+				if (it == chunks.end()) return Voxel{};
+				return it->second[chunk_local<ChunkSize>(coord)];
+			}
+
+			[[nodiscard]] constexpr std::optional<Bounds> support() const {
+				return occupied;
+			}
+
+			[[nodiscard]] std::size_t bytes() const noexcept {
+				std::size_t total = sizeof(Cache) + chunks.bucket_count() * sizeof(void*);
+				for (const auto& [_, chunk] : chunks) {
+					total += chunk.bytes() + sizeof(Coord);
+				}
+				return total;
+			}
+
+			explicit Cache(const Sampler& sampler, const Bounds& bounds) :
+				bounds(bounds), occupied(clip_to_support(bounds, sampler)) {
+				if (support_detail::is_empty(occupied)) return;
+				each_chunk<ChunkSize>(occupied, [&](const Coord coord) {
+					auto chunk = Chunk::sample(sampler, coord, bounds);
+					// empty chunks are implied by absence
+					if (chunk.is_uniform() && chunk.uniform == Voxel{}) return;
+					chunks.emplace(coord, std::move(chunk));
+				});
+			}
+		};
+
+		return Cache(sampler, bounds);
+	}
+}
+
+#endif //CYREX_VOXELS_CHUNK_H
@@ -0,0 +1,230 @@
+//
+// Sparse voxel DAG: an octree where identical subtrees are stored once
+
+#ifndef CYREX_VOXELS_DAG_H
+#define CYREX_VOXELS_DAG_H
+
+#include <cyrex_voxels/vox/octree.h>
+#include <cyrex_voxels/vox/parallel.h>
+#include <array>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+namespace vox {
+	namespace dag_detail {
+		// floats and glm vectors of floats, where -0 == 0 but the bytes differ
+		template<typename Voxel>
+		constexpr bool float_voxel = std::is_floating_point_v<Voxel>;
+
+		template<typename Voxel>
+			requires requires { typename Voxel::value_type; Voxel::length(); }
+		constexpr bool float_voxel<Voxel> = std::is_floating_point_v<typename Voxel::value_type> &&
+			sizeof(Voxel) == Voxel::length() * sizeof(typename Voxel::value_type);
+
+		// -0 folded into 0 so voxels that compare equal have the same bytes
+		template<typename Voxel>
+		[[nodiscard]] constexpr Voxel canonical(Voxel voxel) noexcept {
+			if constexpr (std::is_floating_point_v<Voxel>) {
+				return voxel == Voxel(0) ? Voxel(0) : voxel;
+			} else if constexpr (float_voxel<Voxel>) {
+				for (int i = 0; i < Voxel::length(); ++i) voxel[i] = canonical(voxel[i]);
+				return voxel;
+			} else {
+				return voxel;
+			}
+		}
+
+		// hashes the object representation, so voxels that compare equal must have equal bytes:
+		// no padding, and floats are made canonical first
+		template<typename Voxel>
+		struct ByteHash {
+			static_assert(std::has_unique_object_representations_v<Voxel> || float_voxel<Voxel>,
+				"dag_cache needs voxels without padding whose equal values have equal bytes");
+
+			[[nodiscard]] std::size_t operator()(const Voxel& voxel) const noexcept {
+				const Voxel value = canonical(voxel);
+				char bytes[sizeof(Voxel)];
+				std::memcpy(bytes, &value, sizeof(Voxel));
+				return std::hash<std::string_view>{}(std::string_view(bytes, sizeof(Voxel)));
+			}
+		};
+	}
+
+	// Sparse voxel DAG over a bounds.
+	// Every subtree is hashed and interned, so repeated structure (repeat(), mirror(), flat ground)
+	// is stored once and shared. Lookups walk O(depth) nodes like the octree.
+	template<typename Voxel>
+	struct VoxelDag {
+		using Ref = std::uint32_t;
+
+		// refs with this bit set index the leaf palette, otherwise the node array
+		static constexpr Ref leaf_bit = 1u << 31;
+
+		struct Node {
+			std::array<Ref, 8> children{};
+
+			[[nodiscard]] constexpr bool operator==(const Node&) const = default;
+		};
+
+		struct NodeHash {
+			[[nodiscard]] constexpr std::size_t operator()(const Node& node) const noexcept {
+				std::size_t hash = 0;
+				for (const Ref child : node.children) {
+					hash = (hash ^ child) * 0x100000001b3ull;
+				}
+				return hash;
+			}
+		};
+
+		std::vector<Node> nodes;
+		std::vector<Voxel> leaves;
+		Ref root{};
+		Bounds bounds;
+		int size{};
+
+		[[nodiscard]] constexpr Voxel operator ()(const Coord coord) const {
+			if (!bounds.contains(coord)) return Voxel{};
+
+			Coord local = coord - bounds.from;
+			Ref ref = root;
+			int extent = size;
+
+			while (!(ref & leaf_bit)) {
+				extent /= 2;
+				const int child = octree_detail::child_of(local, extent);
+				local -= octree_detail::child_offset(child, extent);
+				ref = nodes[ref].children[child];
+			}
+
+			return leaves[ref & ~leaf_bit];
+		}
+
+		[[nodiscard]] constexpr std::size_t bytes() const noexcept {
+			return sizeof(VoxelDag) + nodes.capacity() * sizeof(Node) + leaves.capacity() * sizeof(Voxel);
+		}
+
+		// Top level subtrees are built on separate threads with their own intern tables,
+		// then merged into the shared table. Children always precede their parents in a
+		// table, so merging is a single forward pass.
+		// threads > 1 calls the sampler concurrently, only pass it for samplers that are safe to call
+		// from several threads at once.
+		template<VoxelSampler Sampler>
+		explicit VoxelDag(const Sampler& sampler, const Bounds& bounds, const unsigned threads = 1) :
+			bounds(bounds), size(octree_detail::root_size(bounds)) {
+
+			int split_depth = 0;
+			for (std::size_t subtrees = 1; subtrees < threads * 4ull && (size >> split_depth) > 1; subtrees *= 8) {
+				++split_depth;
+			}
+
+			const int split_extent = size >> split_depth;
+			const int per_axis = 1 << split_depth;
+
+			std::vector<Builder> builders(static_cast<std::size_t>(per_axis) * per_axis * per_axis);
+			std::vector<Ref> subtree_roots(builders.size());
+
+			parallel_for(builders.size(), [&](const std::size_t i) {
+				const int index = static_cast<int>(i);
+				const Coord cell{index % per_axis, (index / per_axis) % per_axis, index / (per_axis * per_axis)};
+				subtree_roots[i] = builders[i].build(sampler, this->bounds, this->bounds.from + cell * split_extent, split_extent);
+			}, threads);
+
+			Builder merged;
+			for (std::size_t i = 0; i < builders.size(); ++i) {
+				subtree_roots[i] = merged.merge(builders[i], subtree_roots[i]);
+				builders[i] = {};
+			}
+
+			root = merged.join(subtree_roots, Coord{}, per_axis, per_axis);
+			nodes = std::move(merged.nodes);
+			leaves = std::move(merged.leaves);
+		}
+
+	private:
+		struct Builder {
+			std::vector<Node> nodes;
+			std::vector<Voxel> leaves;
+			std::unordered_map<Node, Ref, NodeHash> node_ids;
+			std::unordered_map<Voxel, Ref, dag_detail::ByteHash<Voxel>> leaf_ids;
+
+			Ref intern(const Voxel voxel) {
+				const auto [it, inserted] = leaf_ids.try_emplace(voxel, static_cast<Ref>(leaves.size()) | leaf_bit);
+				if (inserted) leaves.push_back(voxel);
+				return it->second;
+			}
+
+			Ref intern(const Node& node) {
+				// eight identical leaves are just a bigger leaf
+				const Ref first = node.children[0];
+				if ((first & leaf_bit) && std::ranges::all_of(node.children, [=](const Ref r) { return r == first; })) {
+					return first;
+				}
+
+				const auto [it, inserted] = node_ids.try_emplace(node, static_cast<Ref>(nodes.size()));
+				if (inserted) nodes.push_back(node);
+				return it->second;
+			}
+
+			template<VoxelSampler Sampler>
+			Ref build(const Sampler& sampler, const Bounds& bounds, const Coord origin, const int extent) {
+				if (!octree_detail::overlaps({origin, origin + Coord(extent - 1)}, bounds)) return intern(Voxel{});
+				if (extent == 1) return intern(sampler(origin));
+
+				const int half = extent / 2;
+				Node node;
+				for (int child = 0; child < 8; ++child) {
+					node.children[child] = build(sampler, bounds, origin + octree_detail::child_offset(child, half), half);
+				}
+				return intern(node);
+			}
+
+			// re-interns another builder's subtree, returns the ref of its root in this builder
+			Ref merge(const Builder& other, const Ref other_root) {
+				std::vector<Ref> leaf_map(other.leaves.size());
+				for (std::size_t i = 0; i < other.leaves.size(); ++i) {
+					leaf_map[i] = intern(other.leaves[i]);
+				}
+
+				std::vector<Ref> node_map(other.nodes.size());
+				const auto remap = [&](const Ref ref) {
+					return (ref & leaf_bit) ? leaf_map[ref & ~leaf_bit] : node_map[ref];
+				};
+
+				for (std::size_t i = 0; i < other.nodes.size(); ++i) {
+					Node node = other.nodes[i];
+					for (Ref& child : node.children) child = remap(child);
+					node_map[i] = intern(node);
+				}
+
+				return remap(other_root);
+			}
+
+			// builds the levels above the split depth out of already merged subtrees
+			Ref join(const std::vector<Ref>& subtrees, const Coord cell, const int extent, const int per_axis) {
+				if (extent == 1) {
+					return subtrees[cell.x + per_axis * (cell.y + per_axis * cell.z)];
+				}
+
+				const int half = extent / 2;
+				Node node;
+				for (int child = 0; child < 8; ++child) {
+					node.children[child] = join(subtrees, cell + octree_detail::child_offset(child, half), half, per_axis);
+				}
+				return intern(node);
+			}
+		};
+	};
+
+	// threads as for VoxelDag, 1 unless the sampler is safe to call concurrently
+	template<VoxelSampler Sampler>
+	auto dag_cache(const Sampler& sampler, const Bounds bounds, const unsigned threads = 1) {
+		using Voxel = std::invoke_result_t<Sampler, Coord>;
+		static_assert(std::equality_comparable<Voxel>, "dag_cache needs comparable voxels to share subtrees");
+		return VoxelDag<Voxel>(sampler, bounds, threads);
+	}
+}
+
+#endif //CYREX_VOXELS_DAG_H
@@ -0,0 +1,137 @@
+//
+// Euclidean distance fields
+
+#ifndef CYREX_VOXELS_DISTANCE_H
+#define CYREX_VOXELS_DISTANCE_H
+
+#include <cyrex_voxels/vox/voxel.h>
+#include <cyrex_voxels/vox/parallel.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace vox {
+	namespace distance_detail {
+		// stands in for infinity, finite so the parabola maths below stays well defined
+		constexpr float far = 1e20f;
+
+		// Felzenszwalb & Huttenlocher 1D squared distance transform of a sampled function.
+		// f is read and overwritten with stride, scratch buffers are sized by the caller.
+		inline void transform_line(float* f, const int n, const std::size_t stride,
+			std::vector<float>& values, std::vector<int>& hull, std::vector<float>& edges, std::vector<float>& out) {
+			for (int i = 0; i < n; ++i) values[i] = f[i * stride];
+
+			const auto intersect = [&](const int q, const int p) {
+				return ((values[q] + static_cast<float>(q * q)) - (values[p] + static_cast<float>(p * p))) / static_cast<float>(2 * (q - p));
+			};
+
+			int k = 0;
+			hull[0] = 0;
+			edges[0] = -far;
+			edges[1] = far;
+
+			for (int q = 1; q < n; ++q) {
+				float s = intersect(q, hull[k]);
+				while (s <= edges[k]) {
+					--k;
+					s = intersect(q, hull[k]);
+				}
+				++k;
+				hull[k] = q;
+				edges[k] = s;
+				edges[k + 1] = far;
+			}
+
+			k = 0;
+			for (int q = 0; q < n; ++q) {
+				while (edges[k + 1] < static_cast<float>(q)) ++k;
+				const int p = hull[k];
+				out[q] = static_cast<float>((q - p) * (q - p)) + values[p];
+			}
+
+			for (int i = 0; i < n; ++i) f[i * stride] = out[i];
+		}
+	}
+
+	// Distance in voxels from every voxel of the bounds to the nearest visible voxel,
+	// rounded down and clamped to 255. Solid voxels are 0. Exact (not chamfer) and built
+	// with three separable passes, each parallel over its lines when given threads.
+	struct DistanceField {
+		std::vector<std::uint8_t> distances;
+		Bounds bounds;
+
+		// Outside the bounds nothing is known, so report 0 (possibly solid) to stay conservative
+		[[nodiscard]] constexpr std::uint8_t operator ()(const Coord coord) const {
+			if (!bounds.contains(coord)) return 0;
+			const Coord local = coord - bounds.from;
+			const Coord size = bounds.size();
+			return distances[local.x + static_cast<std::size_t>(size.x) * (local.y + static_cast<std::size_t>(size.y) * local.z)];
+		}
+
+		// true if some solid voxel may be within radius, O(1)
+		[[nodiscard]] constexpr bool near_solid(const Coord coord, const float radius) const {
+			return static_cast<float>((*this)(coord)) <= radius;
+		}
+
+		// threads > 1 also samples the bounds in parallel and calls the sampler concurrently, only pass
+		// it for samplers that are safe to call from several threads at once
+		template<VoxelSampler Sampler>
+		explicit DistanceField(const Sampler& sampler, const Bounds& bounds, const unsigned threads = 1) :
+			bounds(bounds) {
+			using traits = voxel_mesh_traits<std::invoke_result_t<Sampler, Coord>>;
+			const Coord size = bounds.size();
+			const std::size_t volume = static_cast<std::size_t>(size.x) * size.y * size.z;
+			const std::size_t row = size.x;
+			const std::size_t slice = row * size.y;
+
+			std::vector<float> squared(volume);
+			parallel_for(size.z, [&](const std::size_t z) {
+				for (int y = 0; y < size.y; ++y) {
+					for (int x = 0; x < size.x; ++x) {
+						const bool solid = traits::is_visible(sampler(bounds.from + Coord(x, y, static_cast<int>(z))));
+						squared[x + y * row + z * slice] = solid ? 0.0f : distance_detail::far;
+					}
+				}
+			}, threads);
+
+			// one pass per axis: line count, line length, stride along the line, line start
+			const auto pass = [&](const std::size_t lines, const int length, const std::size_t stride, auto start) {
+				parallel_for(lines, [&](const std::size_t line) {
+					thread_local std::vector<float> values, edges, out;
+					thread_local std::vector<int> hull;
+					values.resize(length);
+					out.resize(length);
+					hull.resize(length);
+					edges.resize(length + 1);
+					distance_detail::transform_line(&squared[start(line)], length, stride, values, hull, edges, out);
+				}, threads);
+			};
+
+			pass(static_cast<std::size_t>(size.y) * size.z, size.x, 1, [&](const std::size_t line) {
+				return line * row;
+			});
+			pass(static_cast<std::size_t>(size.x) * size.z, size.y, row, [&](const std::size_t line) {
+				return (line % row) + (line / row) * slice;
+			});
+			pass(slice, size.z, slice, [&](const std::size_t line) {
+				return line;
+			});
+
+			distances.resize(volume);
+			parallel_for(size.z, [&](const std::size_t z) {
+				for (std::size_t i = z * slice; i < (z + 1) * slice; ++i) {
+					distances[i] = static_cast<std::uint8_t>(std::min(std::floor(std::sqrt(squared[i])), 255.0f));
+				}
+			}, threads);
+		}
+	};
+
+	// threads as for DistanceField, 1 unless the sampler is safe to call concurrently
+	template<VoxelSampler Sampler>
+	[[nodiscard]] DistanceField distance_field(const Sampler& sampler, const Bounds bounds, const unsigned threads = 1) {
+		return DistanceField(sampler, bounds, threads);
+	}
+}
+
+#endif //CYREX_VOXELS_DISTANCE_H
@@ -0,0 +1,87 @@
+//
+// 2D (x,z) field cache for heightmaps and other per column data
+
+#ifndef CYREX_VOXELS_HEIGHTFIELD_H
+#define CYREX_VOXELS_HEIGHTFIELD_H
+
+#include <cyrex_voxels/vox/voxel.h>
+#include <cyrex_voxels/vox/parallel.h>
+#include <glm/vec2.hpp>
+#include <glm/common.hpp>
+#include <concepts>
+#include <type_traits>
+#include <vector>
+
+namespace vox {
+	// A value per (x,z) column. Lookups index a flat 2D array without touching y,
+	// and operator()(Coord) ignores y so the field can be read straight from a 3D sampler.
+	template<typename Value>
+	struct HeightField {
+		std::vector<Value> values;
+		glm::ivec2 from{};
+		glm::ivec2 to{};
+		int width{};
+
+		static constexpr Axes invariant{.y = true};
+
+		[[nodiscard]] constexpr bool contains(const int x, const int z) const noexcept {
+			return x >= from.x && x <= to.x && z >= from.y && z <= to.y;
+		}
+
+		[[nodiscard]] constexpr Value operator ()(const int x, const int z) const {
+			if (!contains(x, z)) return Value{};
+			return values[(x - from.x) + width * (z - from.y)];
+		}
+
+		[[nodiscard]] constexpr Value operator ()(const Coord coord) const {
+			return (*this)(coord.x, coord.z);
+		}
+
+		// Bilinear interpolation between the four surrounding columns, clamped to the edges
+		[[nodiscard]] constexpr Value sample(const glm::vec2 xz) const requires std::floating_point<Value> {
+			const glm::vec2 clamped = glm::clamp(xz, glm::vec2(from), glm::vec2(to));
+			const glm::ivec2 low = glm::floor(clamped);
+			const glm::ivec2 high = glm::min(low + glm::ivec2(1), to);
+			const glm::vec2 t = clamped - glm::vec2(low);
+
+			const auto at = [&](const int x, const int z) {
+				return values[(x - from.x) + width * (z - from.y)];
+			};
+
+			const Value near_row = at(low.x, low.y) * (1 - t.x) + at(high.x, low.y) * t.x;
+			const Value far_row = at(low.x, high.y) * (1 - t.x) + at(high.x, high.y) * t.x;
+			return near_row * (1 - t.y) + far_row * t.y;
+		}
+
+		// Samples the xz extent of the bounds at y = bounds.from.y.
+		// threads > 1 fills the rows in parallel and calls the sampler concurrently, only pass it for
+		// samplers that are safe to call from several threads at once. bool fields are always filled
+		// on one thread since std::vector<bool> rows share words.
+		template<VoxelSampler Sampler>
+		explicit HeightField(const Sampler& sampler, const Bounds& bounds, const unsigned threads = 1) :
+			from(bounds.from.x, bounds.from.z),
+			to(bounds.to.x, bounds.to.z),
+			width(bounds.size().x) {
+			const int depth = bounds.size().z;
+			values.resize(static_cast<std::size_t>(width) * depth);
+
+			parallel_for(depth, [&](const std::size_t row) {
+				const int z = from.y + static_cast<int>(row);
+				for (int x = from.x; x <= to.x; ++x) {
+					values[(x - from.x) + width * row] = static_cast<Value>(sampler(Coord(x, bounds.from.y, z)));
+				}
+			}, std::is_same_v<Value, bool> ? 1u : threads);
+		}
+	};
+
+	// Value defaults to the sampler's result, pass float to store heights as floats.
+	// threads as for HeightField, 1 unless the sampler is safe to call concurrently.
+	template<typename Value = void, VoxelSampler Sampler>
+	constexpr auto heightfield_cache(const Sampler& sampler, const Bounds bounds, const unsigned threads = 1) {
+		using Result = std::invoke_result_t<Sampler, Coord>;
+		using Stored = std::conditional_t<std::is_void_v<Value>, Result, Value>;
+		return HeightField<Stored>(sampler, bounds, threads);
+	}
+}
+
+#endif //CYREX_VOXELS_HEIGHTFIELD_H
@@ -0,0 +1,332 @@
+//
+// Append only edit journal on top of a region file
+
+#ifndef CYREX_VOXELS_JOURNAL_H
+#define CYREX_VOXELS_JOURNAL_H
+
+// appends and syncs through POSIX calls, src/vox/journal.cpp is only built on unix
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "journals are POSIX only for now"
+#endif
+
+#include <cyrex_voxels/vox/region.h>
+#include <cyrex_voxels/vox/store.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+
+namespace vox {
+	// A file opened for appending, the OS side of a Journal
+	class AppendFile {
+	public:
+		[[nodiscard]] static std::expected<AppendFile, RegionError> open(std::string_view path);
+
+		[[nodiscard]] std::expected<void, RegionError> append(std::span<const std::byte> bytes);
+		// drops everything after size, used to cut off a record torn by a crash
+		[[nodiscard]] std::expected<void, RegionError> truncate(std::uint64_t size);
+		[[nodiscard]] std::expected<void, RegionError> sync();
+
+		[[nodiscard]] std::uint64_t size() const noexcept {
+			return length;
+		}
+
+		~AppendFile();
+		AppendFile(AppendFile&&) noexcept;
+		AppendFile& operator =(AppendFile&&) noexcept;
+	private:
+		AppendFile(std::string path, const int descriptor, const std::uint64_t length) :
+			path(std::move(path)), descriptor(descriptor), length(length) {}
+		AppendFile(const AppendFile&) = delete;
+		AppendFile& operator =(const AppendFile&) = delete;
+		std::string path;
+		int descriptor{-1};
+		std::uint64_t length{};
+	};
+
+	// Layout, all native endian:
+	//   FileHeader
+	//   records: RecordHeader, then count entries of a uint32 chunk_index and the raw voxel
+	// Every record carries a CRC-32 of its header and entries. Reading stops at the first record
+	// that is short or fails its check, which is exactly what a crash in the middle of an append leaves.
+	namespace journal_detail {
+		constexpr std::array<char, 8> magic{'C', 'Y', 'J', 'O', 'U', 'R', 'N', 'L'};
+		constexpr std::uint32_t version = 1;
+		constexpr std::uint32_t record_magic = 0x4a52'4543;
+
+		struct FileHeader {
+			std::array<char, 8> magic;
+			std::uint32_t version;
+			std::uint32_t chunk_size;
+			std::uint32_t voxel_size;
+			std::uint32_t reserved;
+		};
+
+		struct RecordHeader {
+			std::uint32_t magic;
+			std::uint32_t count;
+			std::array<std::int32_t, 3> chunk;
+			// over the header with this field zeroed, followed by the entries
+			std::uint32_t checksum;
+		};
+
+		[[nodiscard]] std::uint32_t crc32(std::span<const std::byte> bytes, std::uint32_t crc = 0);
+
+		[[nodiscard]] bool exists(std::string_view path);
+		[[nodiscard]] std::expected<void, RegionError> rename(std::string_view from, std::string_view to);
+		[[nodiscard]] std::expected<void, RegionError> remove(std::string_view path);
+
+		[[nodiscard]] inline std::string sealed_path(const std::string_view path) {
+			return std::string(path) + ".compacting";
+		}
+	}
+
+	// Records every voxel a ChunkStore changes as small per chunk delta records, so saving costs
+	// the edits made since the last save rather than the whole world. compact() folds the journal
+	// into a region file; replay() rebuilds a store from that region file plus the journal.
+	//
+	// Records store absolute voxel values, so replaying an edit the base file already holds is
+	// harmless. That is what lets compaction run beside the writer: it seals the current journal,
+	// writes a snapshot taken at that moment, then deletes the sealed journal. A crash at any
+	// point leaves a base file and journals that replay to the same world.
+	template<typename Voxel, int Size = default_chunk_size>
+	class Journal {
+		static_assert(std::is_trivially_copyable_v<Voxel>, "journals store voxels as raw bytes");
+		using Header = journal_detail::RecordHeader;
+
+	public:
+		using Store = ChunkStore<Voxel, Size>;
+		using Snapshot = typename Store::Snapshot;
+		using Chunk = typename Store::Chunk;
+
+		static constexpr std::size_t entry_size = sizeof(std::uint32_t) + sizeof(Voxel);
+
+		// Opens or creates the journal, cutting off anything a crash left half written
+		[[nodiscard]] static std::expected<Journal, RegionError> open(const std::string_view path) {
+			const std::string name(path);
+			auto valid = valid_length(name);
+			if (!valid) return std::unexpected(valid.error());
+
+			auto file = AppendFile::open(name);
+			if (!file) return std::unexpected(file.error());
+			if (*valid < file->size()) {
+				if (auto truncated = file->truncate(*valid); !truncated) return std::unexpected(truncated.error());
+			}
+			if (file->size() == 0) {
+				if (auto written = write_header(*file); !written) return std::unexpected(written.error());
+			}
+			return Journal(name, std::move(*file));
+		}
+
+		// Appends one record per chunk whose voxels differ between the snapshots. Call it with the
+		// snapshots either side of each publish. Not synced, see sync().
+		[[nodiscard]] std::expected<void, RegionError> record(const Snapshot& before, const Snapshot& after) {
+			std::vector<std::byte> bytes;
+			Store::each_changed_chunk(before, after, [&](const Coord coord, const Chunk* old, const Chunk* now) {
+				const std::size_t start = bytes.size();
+				bytes.resize(start + sizeof(Header));
+
+				std::uint32_t count = 0;
+				Store::each_changed_voxel(old, now, [&](const Coord local, const Voxel& voxel) {
+					const auto index = static_cast<std::uint32_t>(chunk_index<Size>(local));
+					const std::size_t at = bytes.size();
+					bytes.resize(at + entry_size);
+					std::memcpy(bytes.data() + at, &index, sizeof(index));
+					std::memcpy(bytes.data() + at + sizeof(index), &voxel, sizeof(Voxel));
+					++count;
+				});
+
+				if (count == 0) {
+					bytes.resize(start);
+					return;
+				}
+
+				Header header{journal_detail::record_magic, count, {coord.x, coord.y, coord.z}, 0};
+				std::memcpy(bytes.data() + start, &header, sizeof(header));
+				header.checksum = journal_detail::crc32(std::span(bytes).subspan(start));
+				std::memcpy(bytes.data() + start, &header, sizeof(header));
+			});
+
+			if (bytes.empty()) return {};
+			// one write per call, a crash can only tear the tail
+			const std::scoped_lock lock(*mutex);
+			return file.append(bytes);
+		}
+
+		// Makes recorded edits survive a power cut, not just a crash of the process
+		[[nodiscard]] std::expected<void, RegionError> sync() {
+			const std::scoped_lock lock(*mutex);
+			return file.sync();
+		}
+
+		// Bytes waiting to be compacted
+		[[nodiscard]] std::uint64_t size() const {
+			const std::scoped_lock lock(*mutex);
+			return file.size();
+		}
+
+		// Writes the store into the base region file and drops the journal it now covers.
+		// Safe to call from another thread while the writer keeps editing and recording.
+		[[nodiscard]] std::expected<void, RegionError> compact(const Store& store, const std::string_view base,
+			const unsigned threads = default_thread_count()) {
+			const std::scoped_lock compacting(*compaction);
+			const std::string sealed = journal_detail::sealed_path(path);
+
+			Snapshot snapshot;
+			{
+				const std::scoped_lock lock(*mutex);
+				// a sealed journal left by a failed compaction is folded in by this one instead
+				if (!journal_detail::exists(sealed)) {
+					if (auto sync = file.sync(); !sync) return sync;
+					if (auto moved = journal_detail::rename(path, sealed); !moved) return moved;
+					auto fresh = AppendFile::open(path);
+					if (!fresh) return std::unexpected(fresh.error());
+					file = std::move(*fresh);
+					if (auto written = write_header(file); !written) return written;
+				}
+				// every record written so far is in this snapshot, later ones land in the new journal
+				snapshot = store.snapshot();
+			}
+
+			if (auto saved = save_region<Size>(base, snapshot, store.bounds, threads); !saved) return saved;
+			return journal_detail::remove(sealed);
+		}
+
+		// Rebuilds a world: the base region file if there is one, then the sealed and current journals
+		[[nodiscard]] static std::expected<Store, RegionError> replay(const std::string_view base, const std::string_view path,
+			const Bounds& bounds, const unsigned threads = default_thread_count()) {
+			std::optional<Store> store;
+			if (journal_detail::exists(base)) {
+				auto region = open_region<Voxel, Size>(base);
+				if (!region) return std::unexpected(region.error());
+				store.emplace(*region, bounds, threads);
+			} else {
+				store.emplace(bounds);
+			}
+
+			for (const std::string& journal : {journal_detail::sealed_path(path), std::string(path)}) {
+				if (!journal_detail::exists(journal)) continue;
+				auto mapped = MappedFile::open(journal);
+				if (!mapped) return std::unexpected(mapped.error());
+				// a crash in compact() between creating the new journal and writing its header leaves it empty
+				if (auto checked = check_header(journal, mapped->bytes()); !checked) return std::unexpected(checked.error());
+
+				typename Store::Batch batch;
+				each_record(mapped->bytes(), [&](const Coord chunk, const std::span<const std::byte> entries) {
+					for (std::size_t i = 0; i < entries.size(); i += entry_size) {
+						std::uint32_t index;
+						Voxel voxel;
+						std::memcpy(&index, entries.data() + i, sizeof(index));
+						std::memcpy(&voxel, entries.data() + i + sizeof(index), sizeof(Voxel));
+						const Coord local(index % Size, index / Size % Size, index / (Size * Size));
+						batch.set(chunk * Size + local, voxel);
+					}
+				});
+				store->apply(batch, threads);
+			}
+
+			store->publish();
+			return std::move(*store);
+		}
+
+	private:
+		Journal(std::string path, AppendFile file) :
+			path(std::move(path)),
+			file(std::move(file)),
+			mutex(std::make_unique<std::mutex>()),
+			compaction(std::make_unique<std::mutex>()) {}
+
+		std::string path;
+		AppendFile file;
+		// boxed so the journal stays movable
+		std::unique_ptr<std::mutex> mutex;
+		std::unique_ptr<std::mutex> compaction;
+
+		[[nodiscard]] static std::expected<void, RegionError> write_header(AppendFile& file) {
+			const journal_detail::FileHeader header{
+				.magic = journal_detail::magic,
+				.version = journal_detail::version,
+				.chunk_size = Size,
+				.voxel_size = sizeof(Voxel),
+				.reserved = 0
+			};
+			return file.append(region_detail::as_bytes(header));
+		}
+
+		// Calls fn(chunk, entries) for every intact record, returns how many bytes those cover
+		static std::size_t each_record(const std::span<const std::byte> bytes, auto fn) {
+			std::size_t offset = sizeof(journal_detail::FileHeader);
+			if (bytes.size() < offset) return 0;
+			while (bytes.size() - offset >= sizeof(Header)) {
+				Header header;
+				std::memcpy(&header, bytes.data() + offset, sizeof(header));
+				if (header.magic != journal_detail::record_magic) break;
+
+				const std::size_t length = sizeof(Header) + static_cast<std::size_t>(header.count) * entry_size;
+				if (header.count > Chunk::volume || bytes.size() - offset < length) break;
+
+				const std::uint32_t expected = header.checksum;
+				header.checksum = 0;
+				const std::uint32_t crc = journal_detail::crc32(bytes.subspan(offset + sizeof(Header), length - sizeof(Header)),
+					journal_detail::crc32(region_detail::as_bytes(header)));
+				if (crc != expected) break;
+
+				fn(Coord(header.chunk[0], header.chunk[1], header.chunk[2]), bytes.subspan(offset + sizeof(Header), length - sizeof(Header)));
+				offset += length;
+			}
+			return offset;
+		}
+
+		// An empty file is a journal whose header was never written, anything else must start with ours
+		[[nodiscard]] static std::expected<void, RegionError> check_header(const std::string& path,
+			const std::span<const std::byte> bytes) {
+			if (bytes.empty()) return {};
+			if (bytes.size() < sizeof(journal_detail::FileHeader)) {
+				return std::unexpected(RegionError{path, "too small to be a journal", 0});
+			}
+
+			journal_detail::FileHeader header;
+			std::memcpy(&header, bytes.data(), sizeof(header));
+			if (header.magic != journal_detail::magic || header.version != journal_detail::version) {
+				return std::unexpected(RegionError{path, "not a journal", 0});
+			}
+			if (header.chunk_size != Size || header.voxel_size != sizeof(Voxel)) {
+				return std::unexpected(RegionError{path, "journal was written for another voxel or chunk size", 0});
+			}
+			return {};
+		}
+
+		// Length of the intact prefix of an existing journal, 0 if there is none yet
+		[[nodiscard]] static std::expected<std::uint64_t, RegionError> valid_length(const std::string& path) {
+			if (!journal_detail::exists(path)) return 0;
+			auto mapped = MappedFile::open(path);
+			if (!mapped) return std::unexpected(mapped.error());
+
+			const std::span<const std::byte> bytes = mapped->bytes();
+			if (auto checked = check_header(path, bytes); !checked) return std::unexpected(checked.error());
+			return each_record(bytes, [](const Coord, const std::span<const std::byte>) {});
+		}
+	};
+
+	// Compacts the journal into base every interval until the returned thread is stopped or destroyed.
+	// The journal and store must outlive it. Failures are passed to on_error and retried next time.
+	template<typename Voxel, int Size>
+	[[nodiscard]] std::jthread compact_in_background(Journal<Voxel, Size>& journal, const ChunkStore<Voxel, Size>& store,
+		std::string base, const std::chrono::milliseconds interval, auto on_error) {
+		return std::jthread([&journal, &store, base = std::move(base), interval, on_error](const std::stop_token stop) {
+			std::mutex mutex;
+			std::condition_variable_any wake;
+			std::unique_lock lock(mutex);
+			while (true) {
+				// only a stop request wakes it early
+				wake.wait_for(lock, stop, interval, [] { return false; });
+				if (stop.stop_requested()) return;
+				if (journal.size() <= sizeof(journal_detail::FileHeader)) continue;
+				if (auto compacted = journal.compact(store, base); !compacted) on_error(compacted.error());
+			}
+		});
+	}
+}
+
+#endif //CYREX_VOXELS_JOURNAL_H
@@ -6,6 +6,7 @@
 #define CYREX_VOXELS_MARCHING_H
 
 #include <cyrex_voxels/vox/voxel.h>
+#include <cyrex_voxels/vox/pyramid.h>
 #include <array>
 
 #include <glm/ext/quaternion_geometric.hpp>
@@ -26,11 +27,10 @@ namespace vox {
             {4,5},{5,6},{6,7},{7,4},
             {0,4},{1,5},{2,6},{3,7}
         };
-    }
 
-    template<VoxelSampler Sampler>
-    [[nodiscard]] auto make_marching_mesher(const Sampler& sampler) {
-        return [=](const Bounds& bounds) -> VoxelMesh {
+        // Marches every cube whose lowest corner lies in cubes, corners outside bounds count as empty
+        template<VoxelSampler Sampler>
+        void mesh_cubes(const Sampler& sampler, const Bounds& bounds, const Bounds& cubes, VoxelMesh& mesh) {
             using Voxel = std::invoke_result_t<Sampler, Coord>;
             using traits = voxel_mesh_traits<Voxel>;
 
@@ -39,13 +39,9 @@ namespace vox {
                 return {};
             };
 
-            VoxelMesh mesh{};
-            mesh.vertices.reserve(0xFFFF);
-            mesh.indices.reserve(0xFFFF);
-
-            for (int z = bounds.from.z - 1; z <= bounds.to.z; ++z)
-            for (int y = bounds.from.y - 1; y <= bounds.to.y; ++y)
-            for (int x = bounds.from.x - 1; x <= bounds.to.x; ++x) {
+            for (int z = cubes.from.z; z <= cubes.to.z; ++z)
+            for (int y = cubes.from.y; y <= cubes.to.y; ++y)
+            for (int x = cubes.from.x; x <= cubes.to.x; ++x) {
                 const    Coord base{x, y, z};
                 std::uint8_t cube_index = 0;
                 float values[8];
@@ -53,7 +49,7 @@ namespace vox {
                 Voxel neighbours[8];
 
                 for (int i = 0; i < 8; ++i) {
-                    const Coord p = base + marching_detail::corner_offsets[i];
+                    const Coord p = base + corner_offsets[i];
                     const auto voxel = get(p);
                     neighbours[i] = voxel;
 
@@ -66,7 +62,7 @@ namespace vox {
                     }
                 }
 
-                const int edges = marching_detail::edge_table[cube_index];
+                const int edges = edge_table[cube_index];
                 if (edges == 0) continue;
 
                 glm::vec3 vert_list[12];
@@ -74,8 +70,8 @@ namespace vox {
                 for (int i = 0; i < 12; ++i) {
                     if (!(edges & (1 << i))) continue;
 
-                    const int a = marching_detail::edge_to_corner[i][0];
-                    const int b = marching_detail::edge_to_corner[i][1];
+                    const int a = edge_to_corner[i][0];
+                    const int b = edge_to_corner[i][1];
 
                     // TODO: check if return type is of sampler is a float?
                     const float t = 0.5f; // midpoint (can improve with density interpolation)
@@ -87,7 +83,7 @@ namespace vox {
                     vert_list[i] = mix(positions[a], positions[b], t);
                 }
 
-                const auto& table = marching_detail::tri_table[cube_index];
+                const auto& table = tri_table[cube_index];
 
                 for (int i = 0; table[i] != -1; i += 3) {
                     const auto start_index = mesh.vertices.size();
@@ -99,12 +95,12 @@ namespace vox {
                         v.position = vert_list[edge];
                         v.normal = {0.0f, 1.0f, 0.0f};
 
-                        const int a = marching_detail::edge_to_corner[edge][0];
-                        const int b = marching_detail::edge_to_corner[edge][1];
+                        const int a = edge_to_corner[edge][0];
+                        const int b = edge_to_corner[edge][1];
 
                         const int corner = values[a] > 0.5f ? a : b;
 
-                        const Coord coord = base + marching_detail::corner_offsets[corner];
+                        const Coord coord = base + corner_offsets[corner];
                         const auto& neighbour_voxel = neighbours[corner];
 
                         v.color = traits::color(neighbour_voxel, coord);
@@ -130,10 +126,59 @@ namespace vox {
                     mesh.indices.emplace_back(start_index + 2);
                 }
             }
+        }
+    }
+
+    template<VoxelSampler Sampler>
+    [[nodiscard]] auto make_marching_mesher(const Sampler& sampler) {
+        return [=](const Bounds& bounds) -> VoxelMesh {
+            VoxelMesh mesh{};
+            mesh.vertices.reserve(0xFFFF);
+            mesh.indices.reserve(0xFFFF);
+
+            // a cube needs a corner inside the support to cross the surface, the support is clipped to the
+            // bounds before it is grown so a support reaching the edge of the int range cannot overflow
+            const Bounds occupied = clip_to_support(bounds, sampler);
+            if (!support_detail::is_empty(occupied)) {
+                marching_detail::mesh_cubes(sampler, bounds, Bounds{occupied.from - Coord(1), occupied.to}, mesh);
+            }
+
+            return mesh;
+        };
+    }
+
+    // Same output, but blocks of cubes whose corners the pyramid proves uniform are skipped
+    template<VoxelSampler Sampler>
+    [[nodiscard]] auto make_marching_mesher(const Sampler& sampler, const OccupancyPyramid& pyramid) {
+        return [=, &pyramid](const Bounds& bounds) -> VoxelMesh {
+            VoxelMesh mesh{};
+            mesh.vertices.reserve(0xFFFF);
+            mesh.indices.reserve(0xFFFF);
+
+            const Bounds cubes{bounds.from - Coord(1), bounds.to};
+            const int block_size = pyramid.levels.front().block_size;
+
+            each({Coord(0), (cubes.size() - Coord(1)) / block_size}, [&](const Coord block) {
+                const Coord from = cubes.from + block * block_size;
+                const Bounds region{from, glm::min(from + Coord(block_size - 1), cubes.to)};
+                const Bounds corners{region.from, region.to + Coord(1)};
+
+                // corners outside the bounds read as empty, so only the part inside matters for air
+                const Bounds inside{glm::max(corners.from, bounds.from), glm::min(corners.to, bounds.to)};
+                if (inside.from.x > inside.to.x || inside.from.y > inside.to.y || inside.from.z > inside.to.z) return;
+                const Region state = pyramid.classify(inside);
+                if (state == Region::Empty) return;
+
+                const bool enclosed = bounds.contains(corners.from) && bounds.contains(corners.to);
+                if (enclosed && state == Region::Full) return;
+
+                marching_detail::mesh_cubes(sampler, bounds, region, mesh);
+            });
 
             return mesh;
         };
     }
+
 }
 
 #endif //CYREX_VOXELS_MARCHING_H
\ No newline at end of file
@@ -0,0 +1,146 @@
+//
+// Bounded memo of an expensive sampler
+
+#ifndef CYREX_VOXELS_MEMOIZE_H
+#define CYREX_VOXELS_MEMOIZE_H
+
+#include <cyrex_voxels/vox/chunk.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace vox {
+	// Remembers what an expensive sampler (warp, twist, noise) returned, a brick of BrickSize^3 voxels
+	// at a time, so neighbour lookups, overlapping aprons and repeated rays do not evaluate it again.
+	// Unlike the caches it needs no bounds: bricks are sampled wherever they are first touched and the
+	// least recently used ones are dropped once the memo holds more than budget bytes.
+	// Bricks are spread over Shards independently locked LRU lists, so concurrent readers rarely wait
+	// on each other, and a miss samples its brick without holding any lock.
+	template<int BrickSize = 8, int Shards = 16, VoxelSampler Sampler>
+	auto memoize(const Sampler& sampler, const std::size_t budget) {
+		using Voxel = std::invoke_result_t<Sampler, Coord>;
+		static_assert(std::equality_comparable<Voxel>, "memoize needs comparable voxels to collapse bricks");
+		static_assert(Shards > 0);
+
+		struct Memo {
+			using Brick = Chunk<Voxel, BrickSize>;
+
+			struct Stats {
+				std::uint64_t hits{};
+				std::uint64_t misses{};
+				std::uint64_t evictions{};
+				std::size_t bytes{};
+				std::size_t bricks{};
+			};
+
+			struct Entry {
+				Brick brick;
+				// position in the shard's recency list
+				typename std::list<Coord>::iterator used;
+			};
+
+			struct Shard {
+				std::mutex lock;
+				std::unordered_map<Coord, Entry, CoordHash> bricks;
+				// most recently used first
+				std::list<Coord> order;
+				std::size_t bytes{};
+			};
+
+			// shared, so the memo stays copyable (the meshers take samplers by value) and copies share bricks
+			struct State {
+				std::array<Shard, Shards> shards;
+				std::atomic<std::uint64_t> hits{0};
+				std::atomic<std::uint64_t> misses{0};
+				std::atomic<std::uint64_t> evictions{0};
+			};
+
+			Sampler sampler;
+			// lookups outside it are empty without touching a brick
+			std::optional<Bounds> occupied;
+			// per shard, so one hot shard cannot push out the others
+			std::size_t budget;
+			std::shared_ptr<State> state;
+
+			[[nodiscard]] Voxel operator ()(const Coord coord) const {
+				if (occupied && !occupied->contains(coord)) return Voxel{};
+				const Coord brick = chunk_coord<BrickSize>(coord);
+				const Coord local = chunk_local<BrickSize>(coord);
+				Shard& shard = state->shards[CoordHash{}(brick) % Shards];
+
+				{
+					const std::scoped_lock lock(shard.lock);
+					if (const auto it = shard.bricks.find(brick); it != shard.bricks.end()) {
+						state->hits.fetch_add(1, std::memory_order_relaxed);
+						shard.order.splice(shard.order.begin(), shard.order, it->second.used);
+						return it->second.brick[local];
+					}
+				}
+
+				// another thread may sample the same brick meanwhile, the first one in is kept
+				state->misses.fetch_add(1, std::memory_order_relaxed);
+				Brick sampled = Brick::sample(sampler, brick, chunk_bounds<BrickSize>(brick));
+				const Voxel voxel = sampled[local];
+
+				const std::scoped_lock lock(shard.lock);
+				if (const auto [it, inserted] = shard.bricks.try_emplace(brick); inserted) {
+					it->second.brick = std::move(sampled);
+					shard.order.push_front(brick);
+					it->second.used = shard.order.begin();
+					shard.bytes += entry_bytes(it->second.brick);
+					evict(shard);
+				}
+				return voxel;
+			}
+
+			[[nodiscard]] std::optional<Bounds> support() const {
+				return occupied;
+			}
+
+			[[nodiscard]] Stats stats() const {
+				Stats stats{
+					.hits = state->hits.load(std::memory_order_relaxed),
+					.misses = state->misses.load(std::memory_order_relaxed),
+					.evictions = state->evictions.load(std::memory_order_relaxed)
+				};
+				for (Shard& shard : state->shards) {
+					const std::scoped_lock lock(shard.lock);
+					stats.bytes += shard.bytes;
+					stats.bricks += shard.bricks.size();
+				}
+				return stats;
+			}
+
+			explicit Memo(const Sampler& sampler, const std::size_t budget) :
+				sampler(sampler),
+				occupied(vox::support(sampler)),
+				budget(budget / Shards),
+				state(std::make_shared<State>()) {}
+
+		private:
+			[[nodiscard]] static std::size_t entry_bytes(const Brick& brick) {
+				// the brick plus roughly what the map and list spend on their nodes
+				return brick.bytes() + sizeof(Entry) + sizeof(Coord) * 2 + 4 * sizeof(void*);
+			}
+
+			// shard lock held; the newest brick is always kept, even when it alone is over budget
+			void evict(Shard& shard) const {
+				while (shard.bytes > budget && shard.order.size() > 1) {
+					const auto it = shard.bricks.find(shard.order.back());
+					shard.bytes -= entry_bytes(it->second.brick);
+					shard.bricks.erase(it);
+					shard.order.pop_back();
+					state->evictions.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+		};
+
+		return Memo(sampler, budget);
+	}
+}
+
+#endif //CYREX_VOXELS_MEMOIZE_H
@@ -0,0 +1,171 @@
+//
+// Sparse voxel octree storage
+
+#ifndef CYREX_VOXELS_OCTREE_H
+#define CYREX_VOXELS_OCTREE_H
+
+#include <cyrex_voxels/vox/voxel.h>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+namespace vox {
+	namespace octree_detail {
+		// smallest power of two cube that covers the bounds
+		[[nodiscard]] constexpr int root_size(const Bounds& bounds) {
+			const Coord size = bounds.size();
+			const int extent = std::max({size.x, size.y, size.z, 1});
+			return static_cast<int>(std::bit_ceil(static_cast<unsigned>(extent)));
+		}
+
+		// child ordering: bit 0 = +x, bit 1 = +y, bit 2 = +z
+		[[nodiscard]] constexpr Coord child_offset(const int child, const int half) {
+			return {
+				(child & 1) ? half : 0,
+				(child & 2) ? half : 0,
+				(child & 4) ? half : 0
+			};
+		}
+
+		[[nodiscard]] constexpr int child_of(const Coord local, const int half) {
+			return (local.x >= half ? 1 : 0) |
+				   (local.y >= half ? 2 : 0) |
+				   (local.z >= half ? 4 : 0);
+		}
+
+		[[nodiscard]] constexpr bool overlaps(const Bounds& a, const Bounds& b) {
+			return a.from.x <= b.to.x && a.to.x >= b.from.x &&
+				   a.from.y <= b.to.y && a.to.y >= b.from.y &&
+				   a.from.z <= b.to.z && a.to.z >= b.from.z;
+		}
+	}
+
+	// Sparse voxel octree over a bounds.
+	// Subtrees where every voxel is the same collapse into a single leaf, so large
+	// homogeneous regions (air, solid ground) cost one node instead of one voxel each.
+	template<typename Voxel>
+	struct Octree {
+		static constexpr std::uint32_t leaf = ~0u;
+
+		struct Node {
+			Voxel voxel{};
+			// index of the first of 8 contiguous children, or leaf
+			std::uint32_t children{leaf};
+
+			[[nodiscard]] constexpr bool is_leaf() const noexcept {
+				return children == leaf;
+			}
+		};
+
+		// a uniform region of the tree
+		struct Leaf {
+			Bounds region;
+			Voxel voxel;
+		};
+
+		std::vector<Node> nodes;
+		Node root;
+		Bounds bounds;
+		int size{};
+
+		[[nodiscard]] constexpr Leaf find(const Coord coord) const {
+			Coord local = coord - bounds.from;
+			Coord origin = bounds.from;
+			const Node* node = &root;
+			int extent = size;
+
+			while (!node->is_leaf()) {
+				extent /= 2;
+				const int child = octree_detail::child_of(local, extent);
+				const Coord offset = octree_detail::child_offset(child, extent);
+				local -= offset;
+				origin += offset;
+				node = &nodes[node->children + child];
+			}
+
+			return {{origin, origin + Coord(extent - 1)}, node->voxel};
+		}
+
+		[[nodiscard]] constexpr Voxel operator ()(const Coord coord) const {
+			if (!bounds.contains(coord)) return Voxel{};
+			return find(coord).voxel;
+		}
+
+		// Calls fn(region, voxel) for every uniform leaf overlapping the query,
+		// regions are whole leaf cubes and may extend past the query
+		constexpr void each_leaf(const Bounds& query, auto fn) const {
+			visit(root, bounds.from, size, query, fn);
+		}
+
+		constexpr void each_leaf(auto fn) const {
+			each_leaf(bounds, fn);
+		}
+
+		[[nodiscard]] constexpr std::size_t bytes() const noexcept {
+			return sizeof(Octree) + nodes.capacity() * sizeof(Node);
+		}
+
+		template<VoxelSampler Sampler>
+		explicit Octree(const Sampler& sampler, const Bounds& bounds) :
+			bounds(bounds), size(octree_detail::root_size(bounds)) {
+			root = build(sampler, bounds.from, size);
+		}
+
+	private:
+		constexpr void visit(const Node& node, const Coord origin, const int extent,
+			const Bounds& query, auto& fn) const {
+			const Bounds region{origin, origin + Coord(extent - 1)};
+			if (!octree_detail::overlaps(region, query)) return;
+
+			if (node.is_leaf()) {
+				fn(region, node.voxel);
+				return;
+			}
+
+			const int half = extent / 2;
+			for (int child = 0; child < 8; ++child) {
+				visit(nodes[node.children + child],
+					origin + octree_detail::child_offset(child, half), half, query, fn);
+			}
+		}
+
+		// Children are only appended once we know the node did not collapse,
+		// so collapsed subtrees never leave garbage in the node array
+		template<VoxelSampler Sampler>
+		Node build(const Sampler& sampler, const Coord origin, const int extent) {
+			const Bounds region{origin, origin + Coord(extent - 1)};
+			if (!octree_detail::overlaps(region, bounds)) return Node{};
+
+			if (extent == 1) {
+				return Node{.voxel = sampler(origin)};
+			}
+
+			const int half = extent / 2;
+			Node children[8];
+			bool uniform = true;
+
+			for (int child = 0; child < 8; ++child) {
+				children[child] = build(sampler, origin + octree_detail::child_offset(child, half), half);
+				uniform = uniform &&
+					children[child].is_leaf() &&
+					children[child].voxel == children[0].voxel;
+			}
+
+			if (uniform) return Node{.voxel = children[0].voxel};
+
+			const auto first = static_cast<std::uint32_t>(nodes.size());
+			nodes.insert(nodes.end(), std::begin(children), std::end(children));
+			return Node{.children = first};
+		}
+	};
+
+	template<VoxelSampler Sampler>
+	auto octree_cache(const Sampler& sampler, const Bounds bounds) {
+		using Voxel = std::invoke_result_t<Sampler, Coord>;
+		static_assert(std::equality_comparable<Voxel>, "octree_cache needs comparable voxels to collapse nodes");
+		return Octree<Voxel>(sampler, bounds);
+	}
+}
+
+#endif //CYREX_VOXELS_OCTREE_H
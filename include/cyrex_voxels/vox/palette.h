@@ -0,0 +1,232 @@
+//
+// Palette compressed chunk storage
+
+#ifndef CYREX_VOXELS_PALETTE_H
+#define CYREX_VOXELS_PALETTE_H
+
+#include <cyrex_voxels/vox/chunk.h>
+#include <algorithm>
+#include <cstdint>
+#include <span>
+
+namespace vox {
+	// A chunk stored as a small palette of distinct voxels plus bit packed palette indices.
+	// Index width is the smallest of 0/1/2/4/8/16 bits that fits the palette and grows on write.
+	// Entries are reused once nothing points at them, so the palette never holds more entries than
+	// the chunk has voxels and 16 bits always suffice.
+	// Widths divide 64 so an index never straddles two words.
+	template<typename Voxel, int Size = default_chunk_size>
+	struct PaletteChunk {
+		static constexpr int size = Size;
+		static constexpr int volume = Size * Size * Size;
+		// indices are at most 16 bits, which holds every distinct voxel up to 40^3 chunks
+		static_assert(volume <= 65536, "PaletteChunk indices are 16 bits, chunks must hold at most 65536 voxels");
+
+		std::vector<Voxel> palette{Voxel{}};
+		// how many voxels point at each palette entry
+		std::vector<std::uint32_t> uses{static_cast<std::uint32_t>(volume)};
+		std::vector<std::uint64_t> words;
+		int bits{};
+
+		[[nodiscard]] static constexpr int bits_for(const std::size_t palette_size) {
+			if (palette_size <= 1) return 0;
+			if (palette_size <= 2) return 1;
+			if (palette_size <= 4) return 2;
+			if (palette_size <= 16) return 4;
+			if (palette_size <= 256) return 8;
+			return 16; // a chunk can never hold more distinct voxels than this
+		}
+
+		[[nodiscard]] constexpr std::uint32_t index_at(const int index) const {
+			if (bits == 0) return 0;
+			const int per_word = 64 / bits;
+			const std::uint64_t word = words[index / per_word];
+			const int shift = (index % per_word) * bits;
+			return static_cast<std::uint32_t>((word >> shift) & ((1ull << bits) - 1));
+		}
+
+		[[nodiscard]] constexpr Voxel operator[](const Coord local) const {
+			return palette[index_at(chunk_index<Size>(local))];
+		}
+
+		// An entry whose last voxel is overwritten is reused for the next new voxel, so the
+		// palette only holds values that are still in use and widens only when they need it
+		constexpr void set(const Coord local, const Voxel voxel) {
+			const int index = chunk_index<Size>(local);
+			const std::uint32_t old = index_at(index);
+			if (palette[old] == voxel) return;
+			--uses[old];
+
+			std::size_t entry = palette.size();
+			std::size_t unused = palette.size();
+			for (std::size_t i = 0; i < palette.size(); ++i) {
+				if (palette[i] == voxel) {
+					entry = i;
+					break;
+				}
+				if (uses[i] == 0 && unused == palette.size()) unused = i;
+			}
+
+			if (entry == palette.size() && unused != palette.size()) {
+				entry = unused;
+				palette[entry] = voxel;
+			} else if (entry == palette.size()) {
+				palette.push_back(voxel);
+				uses.push_back(0);
+				if (const int needed = bits_for(palette.size()); needed > bits) repack(needed);
+			}
+			++uses[entry];
+			write(index, static_cast<std::uint32_t>(entry));
+		}
+
+		// Decodes the whole chunk in chunk_index order, a word at a time
+		constexpr void decode(const std::span<Voxel> out) const {
+			if (bits == 0) {
+				std::ranges::fill(out.first(volume), palette.front());
+				return;
+			}
+
+			const int per_word = 64 / bits;
+			const std::uint64_t mask = (1ull << bits) - 1;
+			int index = 0;
+			for (std::uint64_t word : words) {
+				for (int i = 0; i < per_word && index < volume; ++i, ++index) {
+					out[index] = palette[word & mask];
+					word >>= bits;
+				}
+			}
+		}
+
+		[[nodiscard]] constexpr bool is_uniform() const noexcept {
+			return bits == 0;
+		}
+
+		[[nodiscard]] constexpr std::size_t bytes() const noexcept {
+			return sizeof(PaletteChunk) +
+				palette.capacity() * sizeof(Voxel) +
+				uses.capacity() * sizeof(std::uint32_t) +
+				words.capacity() * sizeof(std::uint64_t);
+		}
+
+		// Packs a full chunk worth of voxels given in chunk_index order
+		[[nodiscard]] static PaletteChunk encode(const std::span<const Voxel> voxels) {
+			PaletteChunk chunk;
+			chunk.palette.clear();
+			chunk.uses.clear();
+
+			std::vector<std::uint16_t> indices(volume);
+			std::uint16_t last = 0;
+			for (int i = 0; i < volume; ++i) {
+				// neighbouring voxels usually match, skip the palette search for runs
+				if (!chunk.palette.empty() && voxels[i] == chunk.palette[last]) {
+					indices[i] = last;
+					++chunk.uses[last];
+					continue;
+				}
+				const auto found = std::ranges::find(chunk.palette, voxels[i]);
+				last = static_cast<std::uint16_t>(found - chunk.palette.begin());
+				if (found == chunk.palette.end()) {
+					chunk.palette.push_back(voxels[i]);
+					chunk.uses.push_back(0);
+				}
+				indices[i] = last;
+				++chunk.uses[last];
+			}
+
+			chunk.bits = bits_for(chunk.palette.size());
+			if (chunk.bits != 0) {
+				chunk.words.assign(words_for(chunk.bits), 0);
+				for (int i = 0; i < volume; ++i) chunk.write(i, indices[i]);
+			}
+			return chunk;
+		}
+
+	private:
+		[[nodiscard]] static constexpr std::size_t words_for(const int bits) {
+			const int per_word = 64 / bits;
+			return (volume + per_word - 1) / per_word;
+		}
+
+		constexpr void write(const int index, const std::uint32_t entry) {
+			if (bits == 0) return;
+			const int per_word = 64 / bits;
+			const int shift = (index % per_word) * bits;
+			const std::uint64_t mask = ((1ull << bits) - 1) << shift;
+			auto& word = words[index / per_word];
+			word = (word & ~mask) | (static_cast<std::uint64_t>(entry) << shift);
+		}
+
+		constexpr void repack(const int new_bits) {
+			std::vector<std::uint32_t> indices(volume);
+			for (int i = 0; i < volume; ++i) indices[i] = index_at(i);
+
+			bits = new_bits;
+			words.assign(words_for(bits), 0);
+			for (int i = 0; i < volume; ++i) write(i, indices[i]);
+		}
+	};
+
+	// Materialises a sampler into palette compressed chunks.
+	// Chunks that were entirely empty at build time are not stored until written to.
+	template<int ChunkSize = default_chunk_size, VoxelSampler Sampler>
+	auto palette_cache(const Sampler& sampler, const Bounds bounds) {
+		using Voxel = std::invoke_result_t<Sampler, Coord>;
+		static_assert(std::equality_comparable<Voxel>, "palette_cache needs comparable voxels to build palettes");
+
+		struct Cache {
+			using Chunk = PaletteChunk<Voxel, ChunkSize>;
+
+			std::unordered_map<Coord, Chunk, CoordHash> chunks;
+			Bounds bounds;
+
+			[[nodiscard]] Voxel operator ()(const Coord coord) const {
+				if (!bounds.contains(coord)) return Voxel{};
+				const auto it = chunks.find(chunk_coord<ChunkSize>(coord));
+				if (it == chunks.end()) return Voxel{};
+				return it->second[chunk_local<ChunkSize>(coord)];
+			}
+
+			void set(const Coord coord, const Voxel voxel) {
+				if (!bounds.contains(coord)) return;
+				chunks[chunk_coord<ChunkSize>(coord)].set(chunk_local<ChunkSize>(coord), voxel);
+			}
+
+			// Bulk decode of one chunk for meshers, out must hold Chunk::volume voxels
+			void decode(const Coord chunk, const std::span<Voxel> out) const {
+				const auto it = chunks.find(chunk);
+				if (it == chunks.end()) {
+					std::ranges::fill(out.first(Chunk::volume), Voxel{});
+					return;
+				}
+				it->second.decode(out);
+			}
+
+			[[nodiscard]] std::size_t bytes() const noexcept {
+				std::size_t total = sizeof(Cache) + chunks.bucket_count() * sizeof(void*);
+				for (const auto& [_, chunk] : chunks) {
+					total += chunk.bytes() + sizeof(Coord);
+				}
+				return total;
+			}
+
+			explicit Cache(const Sampler& sampler, const Bounds& bounds) : bounds(bounds) {
+				each_chunk<ChunkSize>(bounds, [&](const Coord coord) {
+					const auto sampled = vox::Chunk<Voxel, ChunkSize>::sample(sampler, coord, bounds);
+					if (sampled.is_uniform() && sampled.uniform == Voxel{}) return;
+
+					if (sampled.is_uniform()) {
+						Chunk chunk;
+						chunk.palette.front() = sampled.uniform;
+						chunks.emplace(coord, std::move(chunk));
+						return;
+					}
+					chunks.emplace(coord, Chunk::encode(sampled.voxels));
+				});
+			}
+		};
+
+		return Cache(sampler, bounds);
+	}
+}
+
+#endif //CYREX_VOXELS_PALETTE_H
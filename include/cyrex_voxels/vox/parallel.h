@@ -0,0 +1,65 @@
+//
+// Minimal fork/join helpers for building caches on every core
+
+#ifndef CYREX_VOXELS_PARALLEL_H
+#define CYREX_VOXELS_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vox {
+	[[nodiscard]] inline unsigned default_thread_count() {
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Calls fn(i, scratch) for every i in [0, count), spread across threads. Each worker calls
+	// make_scratch() once and passes the result to every index it runs, for buffers that should be
+	// allocated once per thread rather than once per item.
+	// Work is handed out one index at a time so uneven items balance themselves.
+	// The first exception thrown by fn is rethrown on the calling thread.
+	void parallel_for_with(const std::size_t count, auto make_scratch, auto fn, const unsigned threads = default_thread_count()) {
+		const std::size_t workers = std::min<std::size_t>(std::max(1u, threads), count);
+		if (workers == 0) return;
+		if (workers == 1) {
+			auto scratch = make_scratch();
+			for (std::size_t i = 0; i < count; ++i) fn(i, scratch);
+			return;
+		}
+
+		std::atomic<std::size_t> next{0};
+		std::exception_ptr error;
+		std::mutex error_mutex;
+
+		const auto work = [&] {
+			try {
+				auto scratch = make_scratch();
+				for (std::size_t i = next++; i < count; i = next++) fn(i, scratch);
+			} catch (...) {
+				const std::scoped_lock lock(error_mutex);
+				if (!error) error = std::current_exception();
+				next = count;
+			}
+		};
+
+		{
+			std::vector<std::jthread> pool;
+			pool.reserve(workers - 1);
+			for (std::size_t i = 1; i < workers; ++i) pool.emplace_back(work);
+			work();
+		}
+
+		if (error) std::rethrow_exception(error);
+	}
+
+	// Calls fn(i) for every i in [0, count), spread across threads
+	void parallel_for(const std::size_t count, auto fn, const unsigned threads = default_thread_count()) {
+		parallel_for_with(count, [] { return 0; }, [&](const std::size_t i, int) { fn(i); }, threads);
+	}
+}
+
+#endif //CYREX_VOXELS_PARALLEL_H
@@ -6,7 +6,11 @@
 #define CYREX_VOXELS_PIPELINE_H
 
 #include <cyrex_voxels/vox/voxel.h>
+#include <algorithm>
 #include <array>
+#include <optional>
+#include <span>
+#include <tuple>
 
 namespace vox {
 	template<typename T>
@@ -18,31 +22,66 @@ namespace vox {
 	struct InvalidSelection{ int selection; };
 
 	template <Selector Selector, VoxelSampler... Samplers>
-	constexpr auto select(const Selector selector, const Samplers... samplers) {
-		static_assert(sizeof...(Samplers) > 0);
-		const auto tuple = std::tuple {samplers...};
+	struct selection {
+		using Voxel = std::invoke_result_t<std::tuple_element_t<0, std::tuple<Samplers...>>, Coord>;
 
-		return [=](const Coord coord) {
-			const auto selection = selector(coord);
+		Selector selector;
+		std::tuple<Samplers...> samplers;
 
-			if (selection < 0 || selection >= static_cast<int>(sizeof...(Samplers))) {
-				throw InvalidSelection{selection};
+		[[nodiscard]] constexpr int select(const Coord coord) const {
+			const auto selected = selector(coord);
+			if (selected < 0 || selected >= static_cast<int>(sizeof...(Samplers))) {
+				throw InvalidSelection{static_cast<int>(selected)};
 			}
+			return static_cast<int>(selected);
+		}
 
-			return [=]<std::size_t... I>(std::index_sequence<I...>) {
-				using ReturnT = decltype(std::get<0>(tuple)(coord));
-				ReturnT result{};
-				bool found = false;
-				(
-					(selection == static_cast<int>(I)
-						? (result = std::get<I>(tuple)(coord), found = true)
-						: result),
-					...
-				);
-
-				return result;
+		constexpr Voxel operator()(const Coord coord) const {
+			const int selected = select(coord);
+			Voxel result{};
+			[&]<std::size_t... I>(std::index_sequence<I...>) {
+				((selected == static_cast<int>(I) ? (result = std::get<I>(samplers)(coord), 0) : 0), ...);
 			}(std::make_index_sequence<sizeof...(Samplers)>{});
-		};
+			return result;
+		}
+
+		// any of the samplers could be picked anywhere
+		[[nodiscard]] constexpr std::optional<Bounds> support() const {
+			return std::apply([](const auto&... sampler) {
+				std::optional<Bounds> box = Bounds{Coord(1), Coord(0)};
+				((box = support_detail::unite(box, vox::support(sampler))), ...);
+				return box;
+			}, samplers);
+		}
+
+		// each stretch of the row that selects the same sampler is sampled as one row
+		constexpr void sample_row(const Coord start, const std::span<Voxel> out) const {
+			std::array<int, row_block> selected;
+			for (std::size_t from = 0; from < out.size(); from += row_block) {
+				const std::size_t count = std::min(row_block, out.size() - from);
+				for (std::size_t i = 0; i < count; ++i) {
+					selected[i] = select(Coord(start.x + static_cast<int>(from + i), start.y, start.z));
+				}
+
+				for (std::size_t run = 0; run < count;) {
+					std::size_t end = run + 1;
+					while (end < count && selected[end] == selected[run]) ++end;
+
+					const Coord run_start(start.x + static_cast<int>(from + run), start.y, start.z);
+					const std::span<Voxel> run_out = out.subspan(from + run, end - run);
+					[&]<std::size_t... I>(std::index_sequence<I...>) {
+						((selected[run] == static_cast<int>(I) ? (vox::sample_row(std::get<I>(samplers), run_start, run_out), 0) : 0), ...);
+					}(std::make_index_sequence<sizeof...(Samplers)>{});
+					run = end;
+				}
+			}
+		}
+	};
+
+	template <Selector Selector, VoxelSampler... Samplers>
+	constexpr auto select(const Selector selector, const Samplers... samplers) {
+		static_assert(sizeof...(Samplers) > 0);
+		return selection<Selector, Samplers...>{selector, std::tuple{samplers...}};
 	}
 }
 
@@ -0,0 +1,48 @@
+//
+// Hierarchical empty/full summaries for skipping uniform regions
+
+#ifndef CYREX_VOXELS_PYRAMID_H
+#define CYREX_VOXELS_PYRAMID_H
+
+#include <cyrex_voxels/vox/occupancy.h>
+#include <vector>
+
+namespace vox {
+	// Marks blocks of the bounds as all empty, all solid or mixed at several scales
+	// (8^3, 64^3, ...). Meshers use it to skip blocks that cannot produce geometry.
+	struct OccupancyPyramid {
+		struct Level {
+			int block_size{};
+			Coord blocks{};
+			std::vector<Region> states;
+
+			[[nodiscard]] Region at(const Coord block) const noexcept {
+				return states[block.x + blocks.x * (block.y + static_cast<std::size_t>(blocks.y) * block.z)];
+			}
+		};
+
+		// finest level first
+		std::vector<Level> levels;
+		Bounds bounds;
+
+		// Conservative: Empty or Full are always exact, but a box that partially covers a mixed
+		// finest-level block, or leaves the bounds, reports Mixed
+		[[nodiscard]] Region classify(const Bounds& box) const noexcept;
+
+		explicit OccupancyPyramid(const Occupancy& occupancy, int block_size = 8, int factor = 8);
+
+		template<VoxelSampler Sampler>
+		explicit OccupancyPyramid(const Sampler& sampler, const Bounds& bounds) :
+			OccupancyPyramid(Occupancy(sampler, bounds)) {}
+
+	private:
+		void classify(std::size_t level, Coord block, const Bounds& box, bool& any_empty, bool& any_full) const noexcept;
+	};
+
+	template<VoxelSampler Sampler>
+	[[nodiscard]] OccupancyPyramid occupancy_pyramid(const Sampler& sampler, const Bounds bounds) {
+		return OccupancyPyramid(sampler, bounds);
+	}
+}
+
+#endif //CYREX_VOXELS_PYRAMID_H
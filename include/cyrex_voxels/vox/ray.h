@@ -5,15 +5,14 @@
 #ifndef CYREX_VOXELS_RAY_H
 #define CYREX_VOXELS_RAY_H
 #include <cyrex_voxels/vox/voxel.h>
+#include <cyrex_voxels/vox/distance.h>
 #include <glm/glm.hpp>
+#include <algorithm>
 #include <optional>
 
 namespace vox {
-
-	template<VoxelSampler Sampler>
-	auto make_raycaster(const Sampler sampler, const Bounds bounds) {
-		using Voxel = decltype(sampler(glm::ivec3{}));
-
+	namespace ray_detail {
+		template<typename Voxel>
 		struct Result {
 			Voxel voxel{};
 			glm::ivec3 point;
@@ -21,42 +20,63 @@ namespace vox {
 			float distance{};
 		};
 
-		const auto raycast = [&](const glm::vec3 origin, const glm::vec3 direction, const float max_distance) -> std::optional<Result> {
+		// Voxel DDA. Before each step skip(point) may return how far along the ray is provably
+		// empty, the walk then jumps ahead and restarts the DDA from there.
+		template<VoxelSampler Sampler>
+		auto cast(const Sampler& sampler, const Bounds& bounds, const glm::vec3 origin, const glm::vec3 direction,
+			const float max_distance, auto skip) -> std::optional<Result<std::invoke_result_t<Sampler, Coord>>> {
+			using Voxel = std::invoke_result_t<Sampler, Coord>;
+			using traits = voxel_mesh_traits<Voxel>;
+
 			if (glm::dot(direction, direction) < 1e-8f) {
 				return std::nullopt;
 			}
 
-			glm::ivec3 point = glm::floor(origin);
 			const glm::ivec3 step = glm::sign(direction);
-
 			const glm::vec3 inv_dir = 1.0f / glm::max(glm::abs(direction), glm::vec3(1e-8f));
-
-			const glm::vec3 next_boundary = glm::vec3(point) +
-				glm::vec3(
-					step.x > 0 ? 1.0f : 0.0f,
-					step.y > 0 ? 1.0f : 0.0f,
-					step.z > 0 ? 1.0f : 0.0f
-				);
-
-			glm::vec3 t_max = (next_boundary - origin) * inv_dir;
 			const glm::vec3 t_delta = glm::vec3(fabs(inv_dir.x), fabs(inv_dir.y), fabs(inv_dir.z));
 
+			glm::ivec3 point;
+			glm::vec3 t_max;
 			float distance = 0.0f;
 			glm::ivec3 normal{0};
 
+			const auto start = [&](const float t) {
+				const glm::vec3 position = origin + direction * t;
+				point = glm::floor(position);
+
+				const glm::vec3 next_boundary = glm::vec3(point) +
+					glm::vec3(
+						step.x > 0 ? 1.0f : 0.0f,
+						step.y > 0 ? 1.0f : 0.0f,
+						step.z > 0 ? 1.0f : 0.0f
+					);
+
+				// inv_dir is unsigned, so measure the gap to the boundary unsigned as well
+				t_max = t + glm::abs(next_boundary - position) * inv_dir;
+				distance = t;
+			};
+
+			start(0.0f);
+
 			while (distance <= max_distance) {
 				if (!bounds.contains(point))
 					break;
 
-				if (const Voxel voxel_value = sampler(point); voxel_value.is_solid()) {
-					return Result {
+				if (const Voxel voxel_value = sampler(point); traits::is_visible(voxel_value)) {
+					return Result<Voxel> {
 						.voxel = voxel_value,
-						.distance = distance,
 						.point = point,
-						.normal = normal
+						.normal = normal,
+						.distance = distance
 					};
 				}
 
+				if (const float jump = skip(point); jump > 0.0f) {
+					start(distance + jump);
+					continue;
+				}
+
 				if (t_max.x < t_max.y && t_max.x < t_max.z) {
 					point.x += step.x;
 					distance = t_max.x;
@@ -78,10 +98,37 @@ namespace vox {
 			}
 
 			return std::nullopt;
+		}
+	}
+
+	template<VoxelSampler Sampler>
+	auto make_raycaster(const Sampler sampler, const Bounds bounds) {
+		return [=](const glm::vec3 origin, const glm::vec3 direction, const float max_distance) {
+			return ray_detail::cast(sampler, bounds, origin, direction, max_distance, [](const Coord) {
+				return 0.0f;
+			});
 		};
+	}
 
-		return raycast;
+	// Sphere traces through empty space using a distance field of the same world.
+	// Anywhere in a voxel whose centre is d voxels from the nearest solid centre, moving
+	// d - 2 along the ray cannot enter a solid voxel (each cube reaches sqrt(3)/2 from its centre),
+	// so hits are still found by a DDA step and report the same point and normal.
+	// The field only knows about solids inside its own bounds, so d is also capped at the distance
+	// to the nearest voxel outside them; a field smaller than the raycaster's bounds is safe, just slower.
+	template<VoxelSampler Sampler>
+	auto make_raycaster(const Sampler sampler, const Bounds bounds, const DistanceField& field) {
+		return [=, &field](const glm::vec3 origin, const glm::vec3 direction, const float max_distance) {
+			const float inv_length = 1.0f / std::sqrt(std::max(glm::dot(direction, direction), 1e-16f));
+			return ray_detail::cast(sampler, bounds, origin, direction, max_distance, [&](const Coord point) {
+				const Coord inside = glm::min(point - field.bounds.from, field.bounds.to - point) + Coord(1);
+				const int edge = std::min({inside.x, inside.y, inside.z});
+				const float clearance = static_cast<float>(std::min(static_cast<int>(field(point)), edge)) - 2.0f;
+				// distance is measured in multiples of direction
+				return clearance >= 1.0f ? clearance * inv_length : 0.0f;
+			});
+		};
 	}
 }
 
-#endif //CYREX_VOXELS_RAY_H
\ No newline at end of file
+#endif //CYREX_VOXELS_RAY_H
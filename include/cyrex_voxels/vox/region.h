@@ -0,0 +1,297 @@
+//
+// Memory mapped region files
+
+#ifndef CYREX_VOXELS_REGION_H
+#define CYREX_VOXELS_REGION_H
+
+// files are mapped and written through POSIX calls, src/vox/region.cpp is only built on unix
+#if !defined(__unix__) && !defined(__APPLE__)
+#error "region files are POSIX only for now"
+#endif
+
+#include <cyrex_voxels/vox/chunk.h>
+#include <cyrex_voxels/vox/parallel.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <iosfwd>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace vox {
+	struct RegionError {
+		std::string path;
+		std::string message;
+		// errno of the failing call, 0 when the file contents are at fault
+		int code{};
+	};
+
+	std::ostream& operator<<(std::ostream&, const RegionError&);
+
+	namespace region_detail {
+		// the error for a failed system call, from errno; shared by the region and journal files
+		[[nodiscard]] RegionError make_error(std::string_view path, std::string_view call);
+	}
+
+	// A whole file mapped read only. Nothing is read up front, pages fault in when first touched.
+	class MappedFile {
+	public:
+		[[nodiscard]] static std::expected<MappedFile, RegionError> open(std::string_view path);
+
+		[[nodiscard]] std::span<const std::byte> bytes() const noexcept {
+			return {data, size};
+		}
+
+		~MappedFile();
+		MappedFile(MappedFile&&) noexcept;
+		MappedFile& operator =(MappedFile&&) noexcept;
+	private:
+		constexpr MappedFile(const std::byte* data, const std::size_t size) : data(data), size(size) {}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator =(const MappedFile&) = delete;
+		const std::byte* data{};
+		std::size_t size{};
+	};
+
+	// Written next to the destination and renamed over it by finish(), so a failed or interrupted
+	// save never leaves a half written file behind
+	class OutputFile {
+	public:
+		[[nodiscard]] static std::expected<OutputFile, RegionError> create(std::string_view path);
+
+		[[nodiscard]] std::expected<void, RegionError> append(std::span<const std::byte> bytes);
+		[[nodiscard]] std::expected<void, RegionError> write_at(std::uint64_t offset, std::span<const std::byte> bytes);
+		[[nodiscard]] std::expected<void, RegionError> finish();
+
+		[[nodiscard]] std::uint64_t size() const noexcept {
+			return written;
+		}
+
+		~OutputFile();
+		OutputFile(OutputFile&&) noexcept;
+		OutputFile& operator =(OutputFile&&) noexcept;
+	private:
+		OutputFile(std::string path, const int descriptor) : path(std::move(path)), descriptor(descriptor) {}
+		OutputFile(const OutputFile&) = delete;
+		OutputFile& operator =(const OutputFile&) = delete;
+		std::string path;
+		int descriptor{-1};
+		std::uint64_t written{};
+	};
+
+	// Layout, all native endian:
+	//   Header
+	//   Entry per chunk of the chunk grid covering the bounds, x fastest
+	//   payloads, each 64 byte aligned: one voxel for a uniform chunk, Size^3 in chunk_index order otherwise
+	// A fixed index means finding a chunk is arithmetic, and opening a file reads nothing but the index.
+	namespace region_detail {
+		constexpr std::array<char, 8> magic{'C', 'Y', 'R', 'E', 'G', 'I', 'O', 'N'};
+		constexpr std::uint32_t version = 1;
+		constexpr std::uint64_t alignment = 64;
+
+		struct Header {
+			std::array<char, 8> magic;
+			std::uint32_t version;
+			std::uint32_t chunk_size;
+			std::uint32_t voxel_size;
+			std::uint32_t reserved;
+			std::array<std::int32_t, 3> from;
+			std::array<std::int32_t, 3> to;
+			std::uint64_t index_offset;
+		};
+
+		// count is 0 for an empty chunk, 1 for a uniform one and Size^3 otherwise
+		struct Entry {
+			std::uint64_t offset;
+			std::uint64_t count;
+		};
+
+		[[nodiscard]] constexpr std::uint64_t align(const std::uint64_t offset) {
+			return (offset + alignment - 1) / alignment * alignment;
+		}
+
+		[[nodiscard]] std::span<const std::byte> as_bytes(const auto& value) {
+			return std::as_bytes(std::span(&value, 1));
+		}
+	}
+
+	// A saved world opened straight from the page cache. Lookups read the mapping directly,
+	// so opening is instant whatever the file size and worlds larger than memory still work.
+	// Copies share the mapping, so it can be handed to the meshers and caches that copy their sampler.
+	template<typename Voxel, int Size = default_chunk_size>
+	class RegionFile {
+		static_assert(std::is_trivially_copyable_v<Voxel>, "region files store voxels as raw bytes");
+		using Entry = region_detail::Entry;
+
+	public:
+		static constexpr int volume = Size * Size * Size;
+
+		Bounds bounds;
+
+		[[nodiscard]] Voxel operator ()(const Coord coord) const {
+			if (!bounds.contains(coord)) return Voxel{};
+			const std::span<const Voxel> voxels = chunk(chunk_coord<Size>(coord));
+			if (voxels.empty()) return Voxel{};
+			if (voxels.size() == 1) return voxels.front();
+			return voxels[chunk_index<Size>(chunk_local<Size>(coord))];
+		}
+
+		// Zero copy view of a chunk: empty when the chunk holds nothing, one voxel when it is uniform,
+		// otherwise every voxel in chunk_index order
+		[[nodiscard]] std::span<const Voxel> chunk(const Coord chunk) const {
+			const Coord grid = chunk - first;
+			if (grid.x < 0 || grid.y < 0 || grid.z < 0 || grid.x >= chunks.x || grid.y >= chunks.y || grid.z >= chunks.z) {
+				return {};
+			}
+			const Entry& entry = index[grid.x + chunks.x * (grid.y + static_cast<std::size_t>(chunks.y) * grid.z)];
+			return {reinterpret_cast<const Voxel*>(file->bytes().data() + entry.offset), entry.count};
+		}
+
+		[[nodiscard]] static std::expected<RegionFile, RegionError> open(const std::string_view path) {
+			auto mapped = MappedFile::open(path);
+			if (!mapped) return std::unexpected(mapped.error());
+
+			const auto fail = [&](const std::string_view message) {
+				return std::unexpected(RegionError{std::string(path), std::string(message), 0});
+			};
+
+			const std::span<const std::byte> bytes = mapped->bytes();
+			if (bytes.size() < sizeof(region_detail::Header)) return fail("too small to be a region file");
+
+			region_detail::Header header;
+			std::memcpy(&header, bytes.data(), sizeof(header));
+			if (header.magic != region_detail::magic) return fail("not a region file");
+			if (header.version != region_detail::version) return fail("unsupported region file version");
+			if (header.chunk_size != Size) return fail("chunk size does not match");
+			if (header.voxel_size != sizeof(Voxel)) return fail("voxel size does not match");
+
+			const Bounds bounds{
+				{header.from[0], header.from[1], header.from[2]},
+				{header.to[0], header.to[1], header.to[2]}
+			};
+			if (bounds.from.x > bounds.to.x || bounds.from.y > bounds.to.y || bounds.from.z > bounds.to.z) {
+				return fail("bounds are inverted");
+			}
+
+			const Coord first = chunk_coord<Size>(bounds.from);
+			const Coord chunks = chunk_coord<Size>(bounds.to) - first + Coord(1);
+			const std::size_t count = static_cast<std::size_t>(chunks.x) * chunks.y * chunks.z;
+
+			if (header.index_offset % alignof(Entry) != 0 || header.index_offset > bytes.size() ||
+				(bytes.size() - header.index_offset) / sizeof(Entry) < count) {
+				return fail("index is truncated");
+			}
+
+			// checked once here so lookups never have to
+			const auto* index = reinterpret_cast<const Entry*>(bytes.data() + header.index_offset);
+			for (std::size_t i = 0; i < count; ++i) {
+				const Entry& entry = index[i];
+				if (entry.count != 0 && entry.count != 1 && entry.count != volume) return fail("corrupt chunk entry");
+				if (entry.offset % alignof(Voxel) != 0 || entry.offset > bytes.size() ||
+					(bytes.size() - entry.offset) / sizeof(Voxel) < entry.count) {
+					return fail("chunk lies outside the file");
+				}
+			}
+
+			return RegionFile(std::make_shared<const MappedFile>(std::move(*mapped)), bounds, first, chunks, index);
+		}
+
+	private:
+		RegionFile(std::shared_ptr<const MappedFile> file, const Bounds& bounds, const Coord first, const Coord chunks,
+			const Entry* index) :
+			bounds(bounds), file(std::move(file)), first(first), chunks(chunks), index(index) {}
+
+		// index points into the mapping, which stays put however many copies share it
+		std::shared_ptr<const MappedFile> file;
+		Coord first;
+		Coord chunks;
+		const Entry* index;
+	};
+
+	template<typename Voxel, int Size = default_chunk_size>
+	[[nodiscard]] std::expected<RegionFile<Voxel, Size>, RegionError> open_region(const std::string_view path) {
+		return RegionFile<Voxel, Size>::open(path);
+	}
+
+	// Writes everything the sampler (a cache, a store snapshot, a generator) holds inside the bounds.
+	// Chunks are sampled a batch at a time and streamed out in order, so a save never holds more than
+	// one batch in memory. threads > 1 samples each batch in parallel and calls the sampler
+	// concurrently, only pass it for samplers that are safe to call from several threads at once.
+	template<int ChunkSize = default_chunk_size, VoxelSampler Sampler>
+	[[nodiscard]] std::expected<void, RegionError> save_region(const std::string_view path, const Sampler& sampler,
+		const Bounds& bounds, const unsigned threads = 1) {
+		using Voxel = std::invoke_result_t<Sampler, Coord>;
+		using Chunk = vox::Chunk<Voxel, ChunkSize>;
+		using region_detail::Entry;
+		static_assert(std::is_trivially_copyable_v<Voxel>, "region files store voxels as raw bytes");
+		static_assert(std::equality_comparable<Voxel>, "save_region needs comparable voxels to collapse chunks");
+
+		auto output = OutputFile::create(path);
+		if (!output) return std::unexpected(output.error());
+
+		const Coord first = chunk_coord<ChunkSize>(bounds.from);
+		const Coord chunks = chunk_coord<ChunkSize>(bounds.to) - first + Coord(1);
+		const std::size_t count = static_cast<std::size_t>(chunks.x) * chunks.y * chunks.z;
+
+		const region_detail::Header header{
+			.magic = region_detail::magic,
+			.version = region_detail::version,
+			.chunk_size = ChunkSize,
+			.voxel_size = sizeof(Voxel),
+			.reserved = 0,
+			.from = {bounds.from.x, bounds.from.y, bounds.from.z},
+			.to = {bounds.to.x, bounds.to.y, bounds.to.z},
+			.index_offset = region_detail::align(sizeof(region_detail::Header))
+		};
+
+		// the index is written last, once every offset is known
+		std::vector<Entry> index(count, Entry{0, 0});
+		if (auto written = output->append(region_detail::as_bytes(header)); !written) return written;
+		const std::uint64_t payloads = region_detail::align(header.index_offset + count * sizeof(Entry));
+
+		const std::array<std::byte, region_detail::alignment> padding{};
+		const auto pad_to = [&](const std::uint64_t offset) -> std::expected<void, RegionError> {
+			while (output->size() < offset) {
+				const std::size_t gap = std::min<std::uint64_t>(padding.size(), offset - output->size());
+				if (auto written = output->append(std::span(padding).first(gap)); !written) return written;
+			}
+			return {};
+		};
+		if (auto padded = pad_to(payloads); !padded) return padded;
+
+		const std::size_t batch = std::max<std::size_t>(1, std::max(1u, threads) * 4);
+		std::vector<Chunk> sampled(batch);
+		for (std::size_t start = 0; start < count; start += batch) {
+			const std::size_t end = std::min(count, start + batch);
+			const auto coord_of = [&](const std::size_t i) {
+				return first + Coord(i % chunks.x, (i / chunks.x) % chunks.y, i / (static_cast<std::size_t>(chunks.x) * chunks.y));
+			};
+
+			parallel_for(end - start, [&](const std::size_t i) {
+				sampled[i] = Chunk::sample(sampler, coord_of(start + i), bounds);
+			}, threads);
+
+			for (std::size_t i = start; i < end; ++i) {
+				const Chunk& chunk = sampled[i - start];
+				if (chunk.is_uniform() && chunk.uniform == Voxel{}) continue;
+
+				if (auto padded = pad_to(region_detail::align(output->size())); !padded) return padded;
+				index[i].offset = output->size();
+				index[i].count = chunk.is_uniform() ? 1 : Chunk::volume;
+
+				const std::span<const Voxel> voxels = chunk.is_uniform() ? std::span(&chunk.uniform, 1) : std::span(chunk.voxels);
+				if (auto written = output->append(std::as_bytes(voxels)); !written) return written;
+			}
+		}
+
+		if (auto written = output->write_at(header.index_offset, std::as_bytes(std::span(index))); !written) return written;
+		return output->finish();
+	}
+}
+
+#endif //CYREX_VOXELS_REGION_H
@@ -0,0 +1,140 @@
+//
+// Per chunk meshes that follow edits to a ChunkStore
+
+#ifndef CYREX_VOXELS_REMESH_H
+#define CYREX_VOXELS_REMESH_H
+
+#include <cyrex_voxels/vox/blocky.h>
+#include <cyrex_voxels/vox/marching.h>
+#include <cyrex_voxels/vox/store.h>
+#include <optional>
+
+namespace vox {
+	// How each mesher splits into chunks. A chunk's mesh covers region and reads voxels from
+	// region.from - before up to region.to + after, which is what decides the neighbours to
+	// remesh when voxels change.
+	namespace meshing {
+		struct Blocky {
+			static constexpr int before = 1;
+			static constexpr int after = 1;
+
+			// the part of the world the output covers, split between chunks
+			[[nodiscard]] static constexpr Bounds extent(const Bounds& bounds) {
+				return bounds;
+			}
+
+			template<VoxelSampler Sampler>
+			static void mesh(const Sampler& sampler, const Bounds& bounds, const Bounds& region, VoxelMesh& mesh) {
+				blocky_detail::mesh_region(sampler, bounds, region, mesh);
+			}
+		};
+
+		// each cube belongs to the chunk holding its lowest corner
+		struct Marching {
+			static constexpr int before = 0;
+			static constexpr int after = 1;
+
+			[[nodiscard]] static constexpr Bounds extent(const Bounds& bounds) {
+				return {bounds.from - Coord(1), bounds.to};
+			}
+
+			template<VoxelSampler Sampler>
+			static void mesh(const Sampler& sampler, const Bounds& bounds, const Bounds& region, VoxelMesh& mesh) {
+				marching_detail::mesh_cubes(sampler, bounds, region, mesh);
+			}
+		};
+	}
+
+	// One VoxelMesh per chunk of a ChunkStore, kept up to date from successive snapshots.
+	// update() diffs the new snapshot against the last one (chunks the writer never touched share
+	// a pointer and are skipped outright), finds the box of voxels that really changed in each
+	// chunk and remeshes only the chunks whose meshes read those voxels. A voxel edited inside a
+	// chunk costs one remesh, one on a face or edge costs the neighbours that touch it as well.
+	// Works from snapshots only, so it can run on a background thread while the store is edited.
+	template<typename Mesher, typename Voxel, int Size = default_chunk_size>
+	struct ChunkMeshes {
+		using Store = ChunkStore<Voxel, Size>;
+		using Snapshot = typename Store::Snapshot;
+		using Chunk = typename Store::Chunk;
+
+		// chunks with no geometry are not stored
+		std::unordered_map<Coord, VoxelMesh, CoordHash> meshes;
+		// chunks to remesh on the next update
+		std::unordered_set<Coord, CoordHash> dirty;
+		Snapshot current;
+
+		explicit ChunkMeshes(const Snapshot& snapshot, const unsigned threads = default_thread_count()) :
+			current(snapshot) {
+			invalidate(Mesher::extent(current.bounds));
+			remesh(threads);
+		}
+
+		// nullptr if the chunk has no geometry
+		[[nodiscard]] const VoxelMesh* mesh(const Coord chunk) const {
+			const auto it = meshes.find(chunk);
+			return it == meshes.end() ? nullptr : &it->second;
+		}
+
+		// Marks every chunk whose mesh reads a voxel of the region
+		void invalidate(const Bounds& region) {
+			const Bounds extent = Mesher::extent(current.bounds);
+			const Bounds reach = store_detail::intersect({region.from - Coord(Mesher::after), region.to + Coord(Mesher::before)}, extent);
+			if (store_detail::is_empty(reach)) return;
+			each_chunk<Size>(reach, [&](const Coord chunk) {
+				dirty.insert(chunk);
+			});
+		}
+
+		// Moves to a newer snapshot of the same store and remeshes what it changed.
+		// Returns the chunks whose meshes were rebuilt, sorted z, y, x; look them up with mesh().
+		std::vector<Coord> update(const Snapshot& next, const unsigned threads = default_thread_count()) {
+			Store::each_changed_chunk(current, next, [&](const Coord coord, const Chunk* before, const Chunk* after) {
+				if (const auto changed = changes(coord, before, after)) invalidate(*changed);
+			});
+
+			current = next;
+			return remesh(threads);
+		}
+
+	private:
+		// Box around every voxel that differs between two versions of a chunk, nullptr is empty
+		[[nodiscard]] static std::optional<Bounds> changes(const Coord coord, const Chunk* before, const Chunk* after) {
+			std::optional<Bounds> box;
+			Store::each_changed_voxel(before, after, [&](const Coord local, const Voxel&) {
+				if (!box) box = Bounds{local, local};
+				box->from = glm::min(box->from, local);
+				box->to = glm::max(box->to, local);
+			});
+
+			if (!box) return std::nullopt;
+			const Coord origin = coord * Size;
+			return Bounds{origin + box->from, origin + box->to};
+		}
+
+		std::vector<Coord> remesh(const unsigned threads) {
+			std::vector<Coord> chunks(dirty.begin(), dirty.end());
+			std::ranges::sort(chunks, store_detail::chunk_less);
+			dirty.clear();
+
+			const Bounds extent = Mesher::extent(current.bounds);
+			std::vector<VoxelMesh> results(chunks.size());
+			parallel_for(chunks.size(), [&](const std::size_t i) {
+				const Bounds region = store_detail::intersect(chunk_bounds<Size>(chunks[i]), extent);
+				Mesher::mesh(current, current.bounds, region, results[i]);
+			}, threads);
+
+			for (std::size_t i = 0; i < chunks.size(); ++i) {
+				if (results[i].vertices.empty()) meshes.erase(chunks[i]);
+				else meshes.insert_or_assign(chunks[i], std::move(results[i]));
+			}
+			return chunks;
+		}
+	};
+
+	template<typename Mesher, typename Voxel, int Size>
+	[[nodiscard]] auto chunk_meshes(const ChunkStore<Voxel, Size>& store, const unsigned threads = default_thread_count()) {
+		return ChunkMeshes<Mesher, Voxel, Size>(store.snapshot(), threads);
+	}
+}
+
+#endif //CYREX_VOXELS_REMESH_H
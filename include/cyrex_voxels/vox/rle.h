@@ -0,0 +1,92 @@
+//
+// Run length encoded column storage
+
+#ifndef CYREX_VOXELS_RLE_H
+#define CYREX_VOXELS_RLE_H
+
+#include <cyrex_voxels/vox/voxel.h>
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace vox {
+	// Stores every (x,z) column of the bounds as runs of identical voxels along Y.
+	// Heightmap terrain (dirt, a grass voxel, then air) becomes three runs per column.
+	template<typename Voxel>
+	struct ColumnRle {
+		struct Run {
+			Voxel voxel{};
+			// one past the last local y of the run
+			int end{};
+		};
+
+		// runs of every column back to back, column i owns runs[offsets[i]..offsets[i + 1])
+		std::vector<Run> runs;
+		std::vector<std::uint32_t> offsets;
+		Bounds bounds;
+		int width{};
+
+		[[nodiscard]] constexpr std::span<const Run> column(const int x, const int z) const {
+			const int index = (x - bounds.from.x) + width * (z - bounds.from.z);
+			return std::span(runs).subspan(offsets[index], offsets[index + 1] - offsets[index]);
+		}
+
+		[[nodiscard]] constexpr Voxel operator ()(const Coord coord) const {
+			if (!bounds.contains(coord)) return Voxel{};
+			const auto spans = column(coord.x, coord.z);
+			const int local_y = coord.y - bounds.from.y;
+			const auto it = std::ranges::upper_bound(spans, local_y, {}, &Run::end);
+			return it->voxel;
+		}
+
+		// Calls fn(from_y, to_y, voxel) for every run of a column, y range is inclusive and in world space
+		constexpr void each_run(const int x, const int z, auto fn) const {
+			int start = 0;
+			for (const auto& run : column(x, z)) {
+				fn(bounds.from.y + start, bounds.from.y + run.end - 1, run.voxel);
+				start = run.end;
+			}
+		}
+
+		[[nodiscard]] constexpr std::size_t bytes() const noexcept {
+			return sizeof(ColumnRle) +
+				runs.capacity() * sizeof(Run) +
+				offsets.capacity() * sizeof(std::uint32_t);
+		}
+
+		template<VoxelSampler Sampler>
+		explicit ColumnRle(const Sampler& sampler, const Bounds& bounds) : bounds(bounds) {
+			const Coord size = bounds.size();
+			width = size.x;
+			offsets.reserve(static_cast<std::size_t>(size.x) * size.z + 1);
+			offsets.push_back(0);
+
+			for (int z = bounds.from.z; z <= bounds.to.z; ++z) {
+				for (int x = bounds.from.x; x <= bounds.to.x; ++x) {
+					for (int y = bounds.from.y; y <= bounds.to.y; ++y) {
+						const Voxel voxel = sampler(Coord(x, y, z));
+						const int local_end = y - bounds.from.y + 1;
+						const bool extends = runs.size() > offsets.back() && runs.back().voxel == voxel;
+						if (extends) {
+							runs.back().end = local_end;
+						} else {
+							runs.push_back({voxel, local_end});
+						}
+					}
+					offsets.push_back(static_cast<std::uint32_t>(runs.size()));
+				}
+			}
+			runs.shrink_to_fit();
+		}
+	};
+
+	template<VoxelSampler Sampler>
+	auto column_rle_cache(const Sampler& sampler, const Bounds bounds) {
+		using Voxel = std::invoke_result_t<Sampler, Coord>;
+		static_assert(std::equality_comparable<Voxel>, "column_rle_cache needs comparable voxels to merge runs");
+		return ColumnRle<Voxel>(sampler, bounds);
+	}
+}
+
+#endif //CYREX_VOXELS_RLE_H
@@ -6,8 +6,16 @@
 #define CYREX_VOXELS_SAMPLERS_H
 
 #include <cyrex_voxels/vox/voxel.h>
+#include <cyrex_voxels/vox/simd.h>
 #include <glm/geometric.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <concepts>
+#include <functional>
+#include <optional>
+#include <span>
+#include <tuple>
 
 namespace vox {
 	template<typename T>
@@ -19,37 +27,312 @@ namespace vox {
 		VoxelSampler<Sampler> &&
 		std::same_as<bool, std::invoke_result_t<Sampler, Coord>>;
 
+	// The samplers the operators below build. Both forward whole rows to their operands, so a
+	// tree of combinators fills a row with one sample_row per leaf.
+	namespace combine_detail {
+		// short_circuit is the left hand value that decides the result on its own,
+		// the right hand side is then never sampled
+		// rows() combines whole rows of bools with the vector kernels,
+		// support() is where the result can be non empty given where each side can be
+		struct And {
+			static constexpr bool short_circuit = false;
+			[[nodiscard]] constexpr bool operator()(const bool lhs, const bool rhs) const { return lhs && rhs; }
+			static void rows(const std::span<bool> lhs, const std::span<const bool> rhs) { simd::and_rows(lhs, rhs); }
+			static constexpr std::optional<Bounds> support(const std::optional<Bounds>& lhs, const std::optional<Bounds>& rhs) {
+				return support_detail::intersect(lhs, rhs);
+			}
+		};
+
+		struct Or {
+			static constexpr bool short_circuit = true;
+			[[nodiscard]] constexpr bool operator()(const bool lhs, const bool rhs) const { return lhs || rhs; }
+			static void rows(const std::span<bool> lhs, const std::span<const bool> rhs) { simd::or_rows(lhs, rhs); }
+			static constexpr std::optional<Bounds> support(const std::optional<Bounds>& lhs, const std::optional<Bounds>& rhs) {
+				return support_detail::unite(lhs, rhs);
+			}
+		};
+
+		struct Xor {
+			[[nodiscard]] constexpr bool operator()(const bool lhs, const bool rhs) const { return static_cast<bool>(lhs ^ rhs); }
+			static void rows(const std::span<bool> lhs, const std::span<const bool> rhs) { simd::xor_rows(lhs, rhs); }
+			static constexpr std::optional<Bounds> support(const std::optional<Bounds>& lhs, const std::optional<Bounds>& rhs) {
+				return support_detail::unite(lhs, rhs);
+			}
+		};
+
+		struct Not {
+			[[nodiscard]] constexpr bool operator()(const bool value) const { return !value; }
+			static void rows(const std::span<bool> row) { simd::not_row(row); }
+		};
+
+		// empty | empty is taken to be empty
+		struct Blend {
+			[[nodiscard]] constexpr auto operator()(const auto& lhs, const auto& rhs) const { return lhs | rhs; }
+			static constexpr std::optional<Bounds> support(const std::optional<Bounds>& lhs, const std::optional<Bounds>& rhs) {
+				return support_detail::unite(lhs, rhs);
+			}
+		};
+
+		template<typename Op, VoxelSampler Sampler>
+		struct unary {
+			Sampler sampler;
+
+			[[nodiscard]] constexpr auto operator()(const Coord& coord) const {
+				return Op{}(sampler(coord));
+			}
+
+			static constexpr Axes invariant = invariant_axes<Sampler>();
+
+			constexpr void sample_row(const Coord start, const std::span<std::invoke_result_t<Sampler, Coord>> out) const {
+				vox::sample_row(sampler, start, out);
+				apply(out);
+			}
+
+			constexpr void sample_slice(const Coord start, const int width, const std::span<std::invoke_result_t<Sampler, Coord>> out) const
+				requires hoists_slices<Sampler> {
+				vox::sample_slice(sampler, start, width, out);
+				apply(out);
+			}
+
+		private:
+			static constexpr void apply(const std::span<std::invoke_result_t<Sampler, Coord>> out) {
+				if constexpr (requires { Op::rows(out); }) {
+					Op::rows(out);
+				} else {
+					for (auto& voxel : out) voxel = Op{}(voxel);
+				}
+			}
+		};
+
+		template<typename Op, VoxelSampler Lhs, VoxelSampler Rhs>
+		struct binary {
+			using Left = std::invoke_result_t<Lhs, Coord>;
+			using Right = std::invoke_result_t<Rhs, Coord>;
+			using Voxel = std::invoke_result_t<Op, Left, Right>;
+			// rows are combined in place in the left side's buffer, so that only works when both sides
+			// already give the result type; anything else is sampled a voxel at a time
+			static constexpr bool uniform = std::same_as<Left, Voxel> && std::same_as<Right, Voxel>;
+
+			Lhs lhs;
+			Rhs rhs;
+
+			[[nodiscard]] constexpr Voxel operator()(const Coord& coord) const {
+				const Left left = lhs(coord);
+				if constexpr (requires { Op::short_circuit; }) {
+					if (left == Op::short_circuit) return left;
+				}
+				return Op{}(left, rhs(coord));
+			}
+
+			[[nodiscard]] constexpr std::optional<Bounds> support() const {
+				return Op::support(vox::support(lhs), vox::support(rhs));
+			}
+
+			static constexpr Axes invariant = common_axes(invariant_axes<Lhs>(), invariant_axes<Rhs>());
+
+			constexpr void sample_row(const Coord start, const std::span<Voxel> out) const
+				requires uniform {
+				vox::sample_row(lhs, start, out);
+
+				std::array<Voxel, row_block> right;
+				for (std::size_t from = 0; from < out.size(); from += row_block) {
+					const std::span<Voxel> left = out.subspan(from, std::min(row_block, out.size() - from));
+					if constexpr (requires { Op::short_circuit; }) {
+						if (std::ranges::all_of(left, [](const Voxel voxel) { return voxel == Op::short_circuit; })) continue;
+					}
+
+					const std::span<Voxel> next = std::span(right).first(left.size());
+					vox::sample_row(rhs, Coord(start.x + static_cast<int>(from), start.y, start.z), next);
+					apply(left, next);
+				}
+			}
+
+			// only worth it when a side shares work between rows; the right side is sampled into a stack
+			// buffer a few rows, or a run of one row, at a time
+			constexpr void sample_slice(const Coord start, const int width, const std::span<Voxel> out) const
+				requires uniform && (hoists_slices<Lhs> || hoists_slices<Rhs>) {
+				vox::sample_slice(lhs, start, width, out);
+
+				std::array<Voxel, slice_block> right;
+				each_slice_piece(start, width, static_cast<int>(out.size() / width), right.size(),
+					[&](const std::size_t offset, const Coord piece, const int piece_width, const int rows) {
+						// a piece is either whole rows or part of one, so it is contiguous in out as well
+						const std::size_t count = static_cast<std::size_t>(piece_width) * rows;
+						const std::span<Voxel> next = std::span(right).first(count);
+						vox::sample_slice(rhs, piece, piece_width, next);
+						apply(out.subspan(offset, count), next);
+					});
+			}
+
+		private:
+			static constexpr void apply(const std::span<Voxel> left, const std::span<Voxel> right) {
+				if constexpr (requires { Op::rows(left, right); }) {
+					Op::rows(left, right);
+				} else {
+					for (std::size_t i = 0; i < left.size(); ++i) {
+						left[i] = Op{}(left[i], right[i]);
+					}
+				}
+			}
+		};
+
+		// a sampler with the axes it ignores declared, see xz_only and y_only
+		template<VoxelSampler Sampler, Axes Invariant>
+		struct declared {
+			Sampler sampler;
+
+			static constexpr Axes invariant = Invariant;
+
+			[[nodiscard]] constexpr auto operator()(const Coord& coord) const {
+				return sampler(coord);
+			}
+
+			constexpr void sample_row(const Coord start, const std::span<std::invoke_result_t<Sampler, Coord>> out) const
+				requires RowSampler<Sampler> {
+				sampler.sample_row(start, out);
+			}
+
+			[[nodiscard]] constexpr std::optional<Bounds> support() const {
+				return vox::support(sampler);
+			}
+		};
+
+		template<VoxelSampler Column, typename Fn>
+		struct columns {
+			using Value = std::invoke_result_t<Column, Coord>;
+			using Voxel = std::invoke_result_t<Fn, Value, Coord>;
+
+			Column column;
+			Fn fn;
+
+			[[nodiscard]] constexpr Voxel operator()(const Coord& coord) const {
+				return fn(column(coord), coord);
+			}
+
+			constexpr void sample_row(const Coord start, const std::span<Voxel> out) const {
+				sample_slice(start, static_cast<int>(out.size()), out);
+			}
+
+			// each column is looked up once, at the slice's first row, and shared by every row above it
+			constexpr void sample_slice(const Coord start, const int width, const std::span<Voxel> out) const {
+				const std::size_t rows = out.size() / width;
+				std::array<Value, row_block> values;
+				for (std::size_t from = 0; from < static_cast<std::size_t>(width); from += row_block) {
+					const std::size_t count = std::min(row_block, width - from);
+					const int x = start.x + static_cast<int>(from);
+					vox::sample_row(column, Coord(x, start.y, start.z), std::span(values).first(count));
+					for (std::size_t y = 0; y < rows; ++y) {
+						for (std::size_t i = 0; i < count; ++i) {
+							out[from + i + width * y] = fn(values[i], Coord(x + static_cast<int>(i), start.y + static_cast<int>(y), start.z));
+						}
+					}
+				}
+			}
+		};
+
+		template<VoxelSampler Sampler, BooleanSampler Mask>
+		struct carved {
+			using Voxel = std::invoke_result_t<Sampler, Coord>;
+
+			Sampler sampler;
+			Mask mask;
+
+			static constexpr Axes invariant = common_axes(invariant_axes<Sampler>(), invariant_axes<Mask>());
+
+			[[nodiscard]] constexpr Voxel operator()(const Coord& coord) const {
+				if (mask(coord)) return Voxel{};
+				return sampler(coord);
+			}
+
+			// carving only ever takes voxels away
+			[[nodiscard]] constexpr std::optional<Bounds> support() const {
+				return vox::support(sampler);
+			}
+
+			constexpr void sample_row(const Coord start, const std::span<Voxel> out) const {
+				vox::sample_row(sampler, start, out);
+				carve_row(start, out);
+			}
+
+			constexpr void sample_slice(const Coord start, const int width, const std::span<Voxel> out) const
+				requires hoists_slices<Sampler> {
+				vox::sample_slice(sampler, start, width, out);
+				for (std::size_t y = 0; y < out.size() / width; ++y) {
+					carve_row(Coord(start.x, start.y + static_cast<int>(y), start.z), out.subspan(y * width, width));
+				}
+			}
+
+		private:
+			// the mask is only sampled inside its support, holes are usually small next to what they cut
+			constexpr void carve_row(const Coord start, const std::span<Voxel> out) const {
+				if (out.empty()) return;
+				// clipped to the row before any offsets are taken, so a support as wide as the int range is fine
+				const Bounds row{start, Coord(start.x + static_cast<int>(out.size()) - 1, start.y, start.z)};
+				const Bounds holed = clip_to_support(row, mask);
+				if (support_detail::is_empty(holed)) return;
+				const int first = holed.from.x - start.x;
+				const int last = holed.to.x - start.x;
+
+				std::array<bool, row_block> holes;
+				for (int from = first; from <= last; from += static_cast<int>(row_block)) {
+					const std::span<bool> hole = std::span(holes).first(std::min(row_block, static_cast<std::size_t>(last - from + 1)));
+					vox::sample_row(mask, Coord(start.x + from, start.y, start.z), hole);
+					for (std::size_t i = 0; i < hole.size(); ++i) {
+						if (hole[i]) out[from + i] = Voxel{};
+					}
+				}
+			}
+		};
+	}
+
+	// Declares that a sampler ignores y, such as anything read from a heightmap. Slice traversals
+	// (sample_each, the caches) then sample one row of it per z slice and copy it up the others.
+	[[nodiscard]] constexpr auto xz_only(const VoxelSampler auto& sampler) {
+		return combine_detail::declared<std::decay_t<decltype(sampler)>, Axes{.y = true}>{sampler};
+	}
+
+	// Declares that a sampler only depends on y, such as strata or a sea level. Rows of it are
+	// sampled once and filled.
+	[[nodiscard]] constexpr auto y_only(const VoxelSampler auto& sampler) {
+		return combine_detail::declared<std::decay_t<decltype(sampler)>, Axes{.x = true, .z = true}>{sampler};
+	}
+
+	// Terrain from a per column value: fn(column(coord), coord) for each voxel, where column must not
+	// depend on y. Slice traversals look each column up once per slice rather than once per voxel.
+	// Usage: columns(heightmap, [](const float height, const Coord coord) { return coord.y <= height; })
+	template<VoxelSampler Column, typename Fn>
+		requires std::invocable<const Fn&, std::invoke_result_t<Column, Coord>, Coord>
+	[[nodiscard]] constexpr auto columns(const Column& column, const Fn fn) {
+		return combine_detail::columns<Column, Fn>{column, fn};
+	}
+
+	// Voxel{} wherever mask is true, the sampler elsewhere
+	template<VoxelSampler Sampler, BooleanSampler Mask>
+	[[nodiscard]] constexpr auto carve(const Sampler& sampler, const Mask& mask) {
+		return combine_detail::carved<Sampler, Mask>{sampler, mask};
+	}
+
 	namespace bool_ops {
 		[[nodiscard]] constexpr BooleanSampler auto operator && (const BooleanSampler auto& lhs, const BooleanSampler auto& rhs) {
-			return [=](const Coord& coord){
-				return lhs(coord) && rhs(coord);
-			};
+			return combine_detail::binary<combine_detail::And, std::decay_t<decltype(lhs)>, std::decay_t<decltype(rhs)>>{lhs, rhs};
 		}
 
 		[[nodiscard]] constexpr BooleanSampler auto operator || (const BooleanSampler auto& lhs, const BooleanSampler auto& rhs) {
-			return [=](const Coord& coord){
-				return lhs(coord) || rhs(coord);
-			};
+			return combine_detail::binary<combine_detail::Or, std::decay_t<decltype(lhs)>, std::decay_t<decltype(rhs)>>{lhs, rhs};
 		}
 
 		[[nodiscard]] constexpr BooleanSampler auto operator ^ (const BooleanSampler auto& lhs, const BooleanSampler auto& rhs) {
-			return [=](const Coord& coord){
-				return static_cast<bool>(lhs(coord) ^ rhs(coord));
-			};
+			return combine_detail::binary<combine_detail::Xor, std::decay_t<decltype(lhs)>, std::decay_t<decltype(rhs)>>{lhs, rhs};
 		}
 
 		[[nodiscard]] constexpr BooleanSampler auto operator ! (const BooleanSampler auto& unary) {
-			return [=](const Coord& coord){
-				return !unary(coord);
-			};
+			return combine_detail::unary<combine_detail::Not, std::decay_t<decltype(unary)>>{unary};
 		}
 	}
 
 	namespace blend_ops {
 		[[nodiscard]] constexpr VoxelSampler auto operator | (const VoxelSampler auto& lhs, const VoxelSampler auto& rhs) {
-			return [=](const Coord& coord){
-				return lhs(coord) | rhs(coord);
-			};
+			return combine_detail::binary<combine_detail::Blend, std::decay_t<decltype(lhs)>, std::decay_t<decltype(rhs)>>{lhs, rhs};
 		}
 	}
 
@@ -79,12 +362,60 @@ namespace vox {
 				}, samplers);
 			}
 		}
+
+		// only and / or chains know where they can be true
+		[[nodiscard]] constexpr std::optional<Bounds> support() const {
+			constexpr bool all = std::same_as<Op, std::logical_and<>> || std::same_as<Op, std::logical_and<bool>>;
+			constexpr bool any = std::same_as<Op, std::logical_or<>> || std::same_as<Op, std::logical_or<bool>>;
+			if constexpr (sizeof...(Samplers) == 0) {
+				return Bounds{Coord(1), Coord(0)};
+			} else if constexpr (all || any) {
+				return std::apply([&](const auto& first, const auto&... rest) {
+					std::optional<Bounds> box = vox::support(first);
+					((box = all ? support_detail::intersect(box, vox::support(rest)) : support_detail::unite(box, vox::support(rest))), ...);
+					return box;
+				}, samplers);
+			} else {
+				return std::nullopt;
+			}
+		}
+
+		constexpr void sample_row(const Coord start, const std::span<bool> out) const {
+			if constexpr (sizeof...(Samplers) == 0) {
+				std::ranges::fill(out, false);
+			} else {
+				std::apply([&](const auto& first, const auto&... rest) {
+					vox::sample_row(first, start, out);
+
+					std::array<bool, row_block> next;
+					for (std::size_t from = 0; from < out.size(); from += row_block) {
+						const std::span<bool> result = out.subspan(from, std::min(row_block, out.size() - from));
+						const Coord row_start(start.x + static_cast<int>(from), start.y, start.z);
+						([&](const auto& sampler) {
+							vox::sample_row(sampler, row_start, std::span(next).first(result.size()));
+							Op op;
+							for (std::size_t i = 0; i < result.size(); ++i) {
+								result[i] = op(result[i], next[i]);
+							}
+						}(rest), ...);
+					}
+				}, samplers);
+			}
+		}
 	};
 
-	[[nodiscard]] constexpr auto bool_to_voxel(const Voxel auto vox_true, const Voxel auto vox_false) {
-		return [=](const bool cond, const Coord&) {
+	template<Voxel True, Voxel False>
+	struct bool_voxels {
+		True vox_true;
+		False vox_false;
+
+		[[nodiscard]] constexpr auto operator()(const bool cond, const Coord&) const {
 			return cond ? vox_true : vox_false;
-		};
+		}
+	};
+
+	[[nodiscard]] constexpr auto bool_to_voxel(const Voxel auto vox_true, const Voxel auto vox_false) {
+		return bool_voxels{vox_true, vox_false};
 	}
 
 	// Converts one generic voxel type to another generic voxel type
@@ -110,19 +441,148 @@ namespace vox {
 		};
 	}
 
+	// The primitives below test a whole row at once: whatever the row shares (its y and z distance,
+	// whether it crosses the shape at all) is worked out once, and the distance tests along x run
+	// through the vector kernels in simd.h.
+	namespace shape_detail {
+		// inside[i] says whether the voxel i along x from start is in the shape
+		template<typename Converter, typename Voxel>
+		constexpr void convert(const Converter& converter, const std::span<const bool> inside, const Coord start, const std::span<Voxel> out) {
+			for (std::size_t i = 0; i < inside.size(); ++i) {
+				out[i] = converter(inside[i], Coord(start.x + static_cast<int>(i), start.y, start.z));
+			}
+		}
+
+		// Shapes only know where they end when outside maps to Voxel{}, which bool_to_voxel can tell
+		// for voxels that can be compared
+		template<typename Converter>
+		[[nodiscard]] constexpr std::optional<Bounds> support(const Converter& converter, const Bounds& box) {
+			using Voxel = std::invoke_result_t<Converter, bool, Coord>;
+			if constexpr (requires { converter.vox_false; } && std::equality_comparable<Voxel>) {
+				if (converter(false, Coord()) == Voxel{}) return box;
+			}
+			return std::nullopt;
+		}
+
+		// every voxel within sqrt(radius_squared) of centre along an axis
+		[[nodiscard]] inline int reach(const float radius_squared) {
+			return radius_squared < 0.0f ? -1 : static_cast<int>(std::floor(std::sqrt(radius_squared)));
+		}
+
+		// every voxel of the row within sqrt(limit) of centre_x along x, once rest is taken off
+		template<typename Converter, typename Voxel>
+		void within(const Converter& converter, const int centre_x, const float rest, const float limit, const Coord start, const std::span<Voxel> out) {
+			std::array<bool, row_block> inside;
+			for (std::size_t from = 0; from < out.size(); from += row_block) {
+				const std::size_t count = std::min(row_block, out.size() - from);
+				const Coord block(start.x + static_cast<int>(from), start.y, start.z);
+				simd::within(static_cast<float>(block.x - centre_x), rest, limit, std::span(inside).first(count));
+				convert(converter, std::span<const bool>(inside).first(count), block, out.subspan(from, count));
+			}
+		}
+
+		template<typename Converter>
+		struct sphere {
+			using Voxel = std::invoke_result_t<Converter, bool, Coord>;
+
+			Coord origin;
+			float radius_squared;
+			Converter converter;
+
+			[[nodiscard]] constexpr Voxel operator()(const Coord& coord) const {
+				const auto coord_float = glm::vec3(coord - origin);
+				const auto dist_squared = glm::dot(coord_float, coord_float);
+				return converter(dist_squared <= radius_squared, coord);
+			}
+
+			void sample_row(const Coord start, const std::span<Voxel> out) const {
+				const float dy = static_cast<float>(start.y - origin.y);
+				const float dz = static_cast<float>(start.z - origin.z);
+				within(converter, origin.x, dy * dy + dz * dz, radius_squared, start, out);
+			}
+
+			[[nodiscard]] std::optional<Bounds> support() const {
+				const int r = reach(radius_squared);
+				return shape_detail::support(converter, {origin - Coord(r), origin + Coord(r)});
+			}
+		};
+
+		template<typename Converter>
+		struct cylinder {
+			using Voxel = std::invoke_result_t<Converter, bool, Coord>;
+
+			Coord origin;
+			float radius_squared;
+			int height;
+			Converter converter;
+
+			[[nodiscard]] constexpr Voxel operator()(const Coord& coord) const {
+				if (coord.y < origin.y) return Voxel{};
+				if (coord.y > origin.y + height) return Voxel{};
+
+				const auto coord_xz = glm::vec2(coord.x,coord.z);
+				const auto coord_float = coord_xz - glm::vec2(origin.x, origin.z);
+				const auto dist_squared = glm::dot(coord_float, coord_float);
+				return converter(dist_squared <= radius_squared, coord);
+			}
+
+			void sample_row(const Coord start, const std::span<Voxel> out) const {
+				if (start.y < origin.y || start.y > origin.y + height) {
+					std::ranges::fill(out, Voxel{});
+					return;
+				}
+				const float dz = static_cast<float>(start.z - origin.z);
+				within(converter, origin.x, dz * dz, radius_squared, start, out);
+			}
+
+			[[nodiscard]] std::optional<Bounds> support() const {
+				const int r = reach(radius_squared);
+				return shape_detail::support(converter, {{origin.x - r, origin.y, origin.z - r}, {origin.x + r, origin.y + height, origin.z + r}});
+			}
+		};
+
+		template<typename Converter>
+		struct box {
+			using Voxel = std::invoke_result_t<Converter, bool, Coord>;
+
+			Bounds bounds;
+			Converter converter;
+
+			[[nodiscard]] constexpr Voxel operator()(const Coord& coord) const {
+				return converter(bounds.contains(coord), coord);
+			}
+
+			[[nodiscard]] constexpr std::optional<Bounds> support() const {
+				return shape_detail::support(converter, bounds);
+			}
+
+			// a row crosses a box in at most one run, so there is nothing to test per voxel
+			constexpr void sample_row(const Coord start, const std::span<Voxel> out) const {
+				std::array<bool, row_block> inside;
+				const bool crosses = start.y >= bounds.from.y && start.y <= bounds.to.y &&
+									 start.z >= bounds.from.z && start.z <= bounds.to.z;
+				for (std::size_t from = 0; from < out.size(); from += row_block) {
+					const std::size_t count = std::min(row_block, out.size() - from);
+					const Coord block(start.x + static_cast<int>(from), start.y, start.z);
+					std::ranges::fill(inside, false);
+					if (crosses) {
+						const int first = std::clamp(bounds.from.x - block.x, 0, static_cast<int>(count));
+						const int last = std::clamp(bounds.to.x - block.x + 1, 0, static_cast<int>(count));
+						std::fill(inside.begin() + first, inside.begin() + std::max(first, last), true);
+					}
+					convert(converter, std::span<const bool>(inside).first(count), block, out.subspan(from, count));
+				}
+			}
+		};
+	}
+
 	template<BoolToVoxel Converter = decltype(bool_to_voxel(true, false))>
 	[[nodiscard]] constexpr auto sphere(
 		const Coord& origin,
 		const float radius,
 		Converter converter = bool_to_voxel(true, false)
 	) {
-		const float radius_squared = radius * radius;
-
-		return [=](const Coord& coord) {
-			const auto coord_float = glm::vec3(coord - origin);
-			const auto dist_squared = glm::dot(coord_float, coord_float);
-			return converter(dist_squared <= radius_squared, coord);
-		};
+		return shape_detail::sphere<Converter>{origin, radius * radius, converter};
 	}
 
 	template<BoolToVoxel Converter = decltype(bool_to_voxel(true, false))>
@@ -132,25 +592,12 @@ namespace vox {
 		const int height,
 		Converter converter = bool_to_voxel(true, false)
 	) {
-		const float radius_squared = radius * radius;
-		const auto origin_xz = glm::vec2(origin.x,origin.z);
-
-		return [=](const Coord& coord) {
-			if (coord.y < origin.y) return false;
-			if (coord.y > origin.y + height) return false;
-
-			const auto coord_xz = glm::vec2(coord.x,coord.z);
-			const auto coord_float = coord_xz - origin_xz;
-			const auto dist_squared = glm::dot(coord_float, coord_float);
-			return converter(dist_squared <= radius_squared, coord);
-		};
+		return shape_detail::cylinder<Converter>{origin, radius * radius, height, converter};
 	}
 
 	template<BoolToVoxel Converter = decltype(bool_to_voxel(true, false))>
 	[[nodiscard]] constexpr auto box(const Bounds bounds, const Converter converter = bool_to_voxel(true, false)) {
-		return [=](const Coord& coord) {
-			return converter(bounds.contains(coord), coord);
-		};
+		return shape_detail::box<Converter>{bounds, converter};
 	}
 }
 
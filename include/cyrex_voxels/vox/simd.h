@@ -0,0 +1,34 @@
+//
+// Vector kernels for the innermost sampler loops
+
+#ifndef CYREX_VOXELS_SIMD_H
+#define CYREX_VOXELS_SIMD_H
+
+#include <span>
+
+// Each kernel has an AVX-512, an AVX2 and a scalar version. The best one the CPU supports is picked
+// on first use, so the library still runs anywhere while -march=native builds get the wide paths.
+// Rows of bool are treated as bytes holding 0 or 1.
+namespace vox::simd {
+	enum class Level {
+		Scalar,
+		AVX2,
+		AVX512
+	};
+
+	// What the kernels run on this machine
+	[[nodiscard]] Level level() noexcept;
+	[[nodiscard]] const char* name(Level level) noexcept;
+
+	// out[i] = (x + i)^2 + rest <= limit, where x is the row's first offset along the distance axis
+	// and rest the squared distance along the others. Exact while every term stays below 2^24.
+	void within(float x, float rest, float limit, std::span<bool> out) noexcept;
+
+	// left[i] = left[i] op right[i], both the same length
+	void and_rows(std::span<bool> left, std::span<const bool> right) noexcept;
+	void or_rows(std::span<bool> left, std::span<const bool> right) noexcept;
+	void xor_rows(std::span<bool> left, std::span<const bool> right) noexcept;
+	void not_row(std::span<bool> row) noexcept;
+}
+
+#endif //CYREX_VOXELS_SIMD_H
@@ -0,0 +1,422 @@
+//
+// Editable chunked storage with copy-on-write snapshots
+
+#ifndef CYREX_VOXELS_STORE_H
+#define CYREX_VOXELS_STORE_H
+
+#include <cyrex_voxels/vox/chunk.h>
+#include <cyrex_voxels/vox/parallel.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <unordered_set>
+#include <variant>
+
+namespace vox {
+	namespace store_detail {
+		[[nodiscard]] constexpr Bounds intersect(const Bounds& a, const Bounds& b) {
+			return {glm::max(a.from, b.from), glm::min(a.to, b.to)};
+		}
+
+		[[nodiscard]] constexpr bool is_empty(const Bounds& box) {
+			return box.from.x > box.to.x || box.from.y > box.to.y || box.from.z > box.to.z;
+		}
+
+		// deterministic order for reporting chunks, z then y then x
+		[[nodiscard]] constexpr bool chunk_less(const Coord a, const Coord b) {
+			if (a.z != b.z) return a.z < b.z;
+			if (a.y != b.y) return a.y < b.y;
+			return a.x < b.x;
+		}
+	}
+
+	// A list of edits recorded up front and applied to a ChunkStore in one go.
+	// Recording sorts every edit into the chunks it touches, so applying visits each chunk once,
+	// copies it at most once and runs the chunks in parallel. Later edits win where they overlap.
+	template<typename Voxel, int Size = default_chunk_size>
+	struct EditBatch {
+		struct Box {
+			Bounds box;
+			Voxel voxel;
+		};
+
+		struct Sphere {
+			Coord centre;
+			float radius;
+			Voxel voxel;
+		};
+
+		// the sampler is called from several threads while applying, it must be pure
+		struct Region {
+			Bounds region;
+			std::function<Voxel(Coord)> sampler;
+		};
+
+		using Shape = std::variant<Box, Sphere, Region>;
+
+		// one edit as seen by a chunk, either a shape or a single voxel at index
+		struct Entry {
+			std::int32_t shape;
+			std::int32_t index;
+			Voxel voxel;
+		};
+
+		std::vector<Shape> shapes;
+		std::unordered_map<Coord, std::vector<Entry>, CoordHash> chunks;
+
+		void set(const Coord coord, const Voxel voxel) {
+			chunks[chunk_coord<Size>(coord)].push_back({-1, chunk_index<Size>(chunk_local<Size>(coord)), voxel});
+		}
+
+		void fill(const Bounds& box, const Voxel voxel) {
+			if (store_detail::is_empty(box)) return;
+			add(Box{box, voxel}, box, [](const Bounds&) { return true; });
+		}
+
+		// every voxel whose centre is within radius of centre
+		void fill(const Coord centre, const float radius, const Voxel voxel) {
+			if (radius < 0.0f) return;
+			const int reach = static_cast<int>(radius);
+			const float radius_squared = radius * radius;
+			add(Sphere{centre, radius, voxel}, {centre - Coord(reach), centre + Coord(reach)}, [&](const Bounds& chunk) {
+				// skip chunks whose closest voxel is already too far away
+				const glm::vec3 offset = glm::vec3(glm::clamp(centre, chunk.from, chunk.to) - centre);
+				return glm::dot(offset, offset) <= radius_squared;
+			});
+		}
+
+		// writes sampler(coord) over the region
+		template<VoxelSampler Sampler>
+		void apply(const Sampler& sampler, const Bounds& region) {
+			if (store_detail::is_empty(region)) return;
+			add(Region{region, sampler}, region, [](const Bounds&) { return true; });
+		}
+
+		[[nodiscard]] bool empty() const noexcept {
+			return chunks.empty();
+		}
+
+		void clear() {
+			shapes.clear();
+			chunks.clear();
+		}
+
+	private:
+		void add(Shape shape, const Bounds& box, auto touches) {
+			const auto id = static_cast<std::int32_t>(shapes.size());
+			shapes.push_back(std::move(shape));
+			each_chunk<Size>(box, [&](const Coord chunk) {
+				if (touches(chunk_bounds<Size>(chunk))) chunks[chunk].push_back({id, 0, Voxel{}});
+			});
+		}
+	};
+
+	// Chunked voxels for a single writer and any number of readers.
+	// Chunks are reference counted and never modified once published: the writer copies a chunk
+	// the first time it edits it after a publish, so a snapshot keeps seeing the world exactly as
+	// it was while edits carry on. Taking a snapshot is one load of an atomic shared_ptr (libstdc++
+	// guards it with a short internal lock), reading the snapshot afterwards takes no locks.
+	template<typename Voxel, int Size = default_chunk_size>
+	struct ChunkStore {
+		static_assert(std::equality_comparable<Voxel>, "ChunkStore needs comparable voxels to collapse chunks");
+
+		using Chunk = vox::Chunk<Voxel, Size>;
+		using Batch = EditBatch<Voxel, Size>;
+		using ChunkMap = std::unordered_map<Coord, std::shared_ptr<const Chunk>, CoordHash>;
+
+		// What one publish produced, never modified afterwards
+		struct State {
+			ChunkMap chunks;
+			std::uint64_t version{};
+		};
+
+		// An immutable view of the store at one publish, safe to keep and read on any thread
+		struct Snapshot {
+			std::shared_ptr<const State> state;
+			Bounds bounds;
+
+			// increases by one with every publish
+			[[nodiscard]] std::uint64_t version() const noexcept {
+				return state->version;
+			}
+
+			[[nodiscard]] Voxel operator ()(const Coord coord) const {
+				if (!bounds.contains(coord)) return Voxel{};
+				const Chunk* found = chunk(chunk_coord<Size>(coord));
+				return found ? (*found)[chunk_local<Size>(coord)] : Voxel{};
+			}
+
+			// nullptr for chunks that are entirely empty
+			[[nodiscard]] const Chunk* chunk(const Coord chunk) const {
+				const auto it = state->chunks.find(chunk);
+				return it == state->chunks.end() ? nullptr : it->second.get();
+			}
+		};
+
+		Bounds bounds;
+
+		explicit ChunkStore(const Bounds& bounds) : bounds(bounds) {
+			publish();
+		}
+
+		// threads > 1 samples chunks in parallel and calls the sampler concurrently, only pass it for
+		// samplers that are safe to call from several threads at once
+		template<VoxelSampler Sampler>
+		explicit ChunkStore(const Sampler& sampler, const Bounds& bounds, const unsigned threads = 1) :
+			bounds(bounds) {
+			std::vector<Coord> coords;
+			each_chunk<Size>(bounds, [&](const Coord chunk) {
+				coords.push_back(chunk);
+			});
+
+			std::vector<std::optional<Chunk>> sampled(coords.size());
+			parallel_for(coords.size(), [&](const std::size_t i) {
+				auto chunk = Chunk::sample(sampler, coords[i], bounds);
+				if (chunk.is_uniform() && chunk.uniform == Voxel{}) return;
+				sampled[i] = std::move(chunk);
+			}, threads);
+
+			for (std::size_t i = 0; i < coords.size(); ++i) {
+				if (sampled[i]) working.emplace(coords[i], std::make_shared<Chunk>(std::move(*sampled[i])));
+			}
+			publish();
+		}
+
+		// Not safe while other threads are taking snapshots
+		ChunkStore(ChunkStore&& other) noexcept :
+			bounds(other.bounds),
+			working(std::move(other.working)),
+			edited(std::move(other.edited)),
+			published(other.published.load()),
+			version(other.version) {}
+
+		// The writer's view, including edits that have not been published yet. Writer thread only.
+		[[nodiscard]] Voxel operator ()(const Coord coord) const {
+			if (!bounds.contains(coord)) return Voxel{};
+			const auto it = working.find(chunk_coord<Size>(coord));
+			return it == working.end() ? Voxel{} : (*it->second)[chunk_local<Size>(coord)];
+		}
+
+		// Writes outside the bounds are ignored. Writer thread only.
+		void set(const Coord coord, const Voxel voxel) {
+			if (!bounds.contains(coord)) return;
+			const Coord chunk = chunk_coord<Size>(coord);
+			const Coord local = chunk_local<Size>(coord);
+
+			const auto it = working.find(chunk);
+			const Voxel current = it == working.end() ? Voxel{} : (*it->second)[local];
+			if (current == voxel) return;
+
+			write(writable(chunk), chunk_index<Size>(local), voxel);
+		}
+
+		// Applies every edit of the batch and returns exactly the chunks whose voxels changed,
+		// sorted z, y, x. Edits outside the bounds are ignored. Writer thread only.
+		std::vector<Coord> apply(const Batch& batch, const unsigned threads = default_thread_count()) {
+			struct Job {
+				Coord coord;
+				const std::vector<typename Batch::Entry>* entries;
+				std::shared_ptr<const Chunk> original;
+				std::optional<Chunk> result;
+			};
+
+			std::vector<Job> jobs;
+			jobs.reserve(batch.chunks.size());
+			for (const auto& [coord, entries] : batch.chunks) {
+				if (store_detail::is_empty(store_detail::intersect(chunk_bounds<Size>(coord), bounds))) continue;
+				const auto it = working.find(coord);
+				jobs.push_back({coord, &entries, it == working.end() ? nullptr : it->second, std::nullopt});
+			}
+
+			// each job edits a private copy, so a chunk that ends up as it started is not reported
+			parallel_for(jobs.size(), [&](const std::size_t i) {
+				Job& job = jobs[i];
+				Chunk chunk = job.original ? *job.original : Chunk{};
+				if (!apply(batch, *job.entries, job.coord, chunk)) return;
+				chunk.collapse();
+				if (!same(chunk, job.original ? *job.original : Chunk{})) job.result = std::move(chunk);
+			}, threads);
+
+			std::vector<Coord> dirty;
+			for (Job& job : jobs) {
+				if (!job.result) continue;
+				dirty.push_back(job.coord);
+				edited.insert(job.coord);
+				if (job.result->is_uniform() && job.result->uniform == Voxel{}) working.erase(job.coord);
+				else working[job.coord] = std::make_shared<Chunk>(std::move(*job.result));
+			}
+			std::ranges::sort(dirty, store_detail::chunk_less);
+			return dirty;
+		}
+
+		// Chunks written since the last publish
+		[[nodiscard]] const std::unordered_set<Coord, CoordHash>& pending() const noexcept {
+			return edited;
+		}
+
+		// Makes every edit so far visible to snapshot(). Writer thread only.
+		// Costs one pointer copy per stored chunk, voxel data is shared, not copied.
+		void publish() {
+			for (const Coord chunk : edited) {
+				const auto it = working.find(chunk);
+				if (it == working.end()) continue;
+				it->second->collapse();
+				if (it->second->is_uniform() && it->second->uniform == Voxel{}) working.erase(it);
+			}
+			edited.clear();
+
+			auto state = std::make_shared<State>();
+			state->version = ++version;
+			state->chunks.reserve(working.size());
+			for (const auto& [coord, chunk] : working) {
+				state->chunks.emplace(coord, chunk);
+			}
+			published.store(std::move(state), std::memory_order_release);
+		}
+
+		// Any thread
+		[[nodiscard]] Snapshot snapshot() const {
+			return Snapshot{.state = published.load(std::memory_order_acquire), .bounds = bounds};
+		}
+
+		// Calls fn(chunk, before, after) for every chunk that is not shared between two snapshots,
+		// nullptr where a snapshot has no chunk. Chunks the writer never touched are skipped by pointer.
+		static void each_changed_chunk(const Snapshot& before, const Snapshot& after, auto fn) {
+			for (const auto& [coord, chunk] : before.state->chunks) {
+				if (const Chunk* next = after.chunk(coord); next != chunk.get()) fn(coord, chunk.get(), next);
+			}
+			for (const auto& [coord, chunk] : after.state->chunks) {
+				if (!before.state->chunks.contains(coord)) fn(coord, nullptr, chunk.get());
+			}
+		}
+
+		// Calls fn(local, voxel) for every voxel of after that differs from before, nullptr reads as empty
+		static void each_changed_voxel(const Chunk* before, const Chunk* after, auto fn) {
+			const Chunk empty{};
+			const Chunk& a = before ? *before : empty;
+			const Chunk& b = after ? *after : empty;
+			if (a.is_uniform() && b.is_uniform() && a.uniform == b.uniform) return;
+
+			each({Coord(0), Coord(Size - 1)}, [&](const Coord local) {
+				if (const Voxel voxel = b[local]; !(a[local] == voxel)) fn(local, voxel);
+			});
+		}
+
+		[[nodiscard]] std::size_t bytes() const noexcept {
+			std::size_t total = sizeof(ChunkStore) + working.bucket_count() * sizeof(void*);
+			for (const auto& [_, chunk] : working) {
+				total += chunk->bytes() + sizeof(Coord) + sizeof(std::shared_ptr<Chunk>);
+			}
+			return total;
+		}
+
+	private:
+		std::unordered_map<Coord, std::shared_ptr<Chunk>, CoordHash> working;
+		std::unordered_set<Coord, CoordHash> edited;
+		std::atomic<std::shared_ptr<const State>> published;
+		std::uint64_t version{};
+
+		// Chunks edited since the last publish are copies the writer made itself, which no State can
+		// reach yet, so they are edited in place. Anything else may still be read through a snapshot
+		// and is copied first. The reference count is not used for this, a reader dropping the last
+		// snapshot would not be ordered before the writes.
+		Chunk& writable(const Coord chunk) {
+			auto& slot = working[chunk];
+			if (!slot) slot = std::make_shared<Chunk>();
+			else if (!edited.contains(chunk)) slot = std::make_shared<Chunk>(*slot);
+			edited.insert(chunk);
+			return *slot;
+		}
+
+		// returns true if the voxel changed
+		static bool write(Chunk& chunk, const int index, const Voxel voxel) {
+			if (chunk.is_uniform()) {
+				if (chunk.uniform == voxel) return false;
+				chunk.voxels.assign(Chunk::volume, chunk.uniform);
+			}
+			if (chunk.voxels[index] == voxel) return false;
+			chunk.voxels[index] = voxel;
+			return true;
+		}
+
+		[[nodiscard]] static bool same(const Chunk& a, const Chunk& b) {
+			if (a.is_uniform() && b.is_uniform()) return a.uniform == b.uniform;
+			for (int i = 0; i < Chunk::volume; ++i) {
+				const Coord local{i % Size, i / Size % Size, i / (Size * Size)};
+				if (!(a[local] == b[local])) return false;
+			}
+			return true;
+		}
+
+		// runs one chunk's share of a batch in recording order, returns true if anything was written
+		bool apply(const Batch& batch, const std::vector<typename Batch::Entry>& entries, const Coord coord, Chunk& chunk) const {
+			const Bounds area = chunk_bounds<Size>(coord);
+			const Bounds clip = store_detail::intersect(area, bounds);
+			const bool whole = clip.from == area.from && clip.to == area.to;
+			bool changed = false;
+
+			// writes value(coord) over box (already clipped to the chunk) wherever it returns a voxel
+			const auto fill = [&](const Bounds& box, auto value) {
+				each(box, [&](const Coord p) {
+					if (const std::optional<Voxel> voxel = value(p)) {
+						changed = write(chunk, chunk_index<Size>(p - area.from), *voxel) || changed;
+					}
+				});
+			};
+
+			for (const auto& entry : entries) {
+				if (entry.shape < 0) {
+					const Coord local{entry.index % Size, entry.index / Size % Size, entry.index / (Size * Size)};
+					if (clip.contains(area.from + local)) changed = write(chunk, entry.index, entry.voxel) || changed;
+					continue;
+				}
+
+				std::visit([&]<typename Shape>(const Shape& shape) {
+					if constexpr (std::is_same_v<Shape, typename Batch::Box>) {
+						const Bounds box = store_detail::intersect(shape.box, clip);
+						if (store_detail::is_empty(box)) return;
+						if (whole && box.from == area.from && box.to == area.to) {
+							// covers the chunk, no need to visit voxels
+							const bool same = chunk.is_uniform() ? chunk.uniform == shape.voxel :
+								std::ranges::all_of(chunk.voxels, [&](const Voxel& v) { return v == shape.voxel; });
+							changed = changed || !same;
+							chunk.uniform = shape.voxel;
+							chunk.voxels = {};
+							return;
+						}
+						fill(box, [&](const Coord) { return std::optional(shape.voxel); });
+					}
+					else if constexpr (std::is_same_v<Shape, typename Batch::Sphere>) {
+						const int reach = static_cast<int>(shape.radius);
+						const Bounds box = store_detail::intersect({shape.centre - Coord(reach), shape.centre + Coord(reach)}, clip);
+						if (store_detail::is_empty(box)) return;
+						const float radius_squared = shape.radius * shape.radius;
+						fill(box, [&](const Coord p) -> std::optional<Voxel> {
+							const glm::vec3 offset = glm::vec3(p - shape.centre);
+							if (glm::dot(offset, offset) > radius_squared) return std::nullopt;
+							return shape.voxel;
+						});
+					}
+					else {
+						const Bounds box = store_detail::intersect(shape.region, clip);
+						if (store_detail::is_empty(box)) return;
+						fill(box, [&](const Coord p) { return std::optional(shape.sampler(p)); });
+					}
+				}, batch.shapes[entry.shape]);
+			}
+			return changed;
+		}
+	};
+
+	// threads as for ChunkStore, 1 unless the sampler is safe to call concurrently
+	template<int ChunkSize = default_chunk_size, VoxelSampler Sampler>
+	[[nodiscard]] auto chunk_store(const Sampler& sampler, const Bounds bounds, const unsigned threads = 1) {
+		return ChunkStore<std::invoke_result_t<Sampler, Coord>, ChunkSize>(sampler, bounds, threads);
+	}
+}
+
+#endif //CYREX_VOXELS_STORE_H
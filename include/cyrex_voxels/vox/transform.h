@@ -7,6 +7,12 @@
 
 #include <cyrex_voxels/vox/samplers.h>
 #include "glm/gtc/noise.hpp"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <optional>
+#include <span>
+#include <tuple>
 
 namespace vox {
 	template<typename T>
@@ -15,14 +21,76 @@ namespace vox {
 		{ v(Coord())} -> std::same_as<Coord>;
 	};
 
-	template<Transformer T>
+	struct no_preimage {};
+
+	// preimage(box), when given, returns a box holding every coordinate op maps into box,
+	// which is how a chain of transforms carries the support of the sampler at its end
+	template<Transformer T, typename Preimage = no_preimage>
 	struct transform_op {
 		T op;
+		Preimage preimage{};
+
 		constexpr auto operator()(const Coord coord) const {
 			return op(coord);
 		}
 	};
 
+	// A sampler seen through a chain of transforms. Rows are transformed a block at a time and every
+	// stretch that still lands on consecutive x (a translation, a repeat inside its period) is handed
+	// to the sampler as one row.
+	template<VoxelSampler Sampler, typename... Ops>
+	struct transformed {
+		using Voxel = std::invoke_result_t<Sampler, Coord>;
+
+		std::tuple<Ops...> ops;
+		const Sampler& sampler;
+
+		[[nodiscard]] constexpr Coord apply(const Coord coord) const {
+			Coord p = coord;
+			std::apply([&](const auto&... op) {
+				((p = op(p)), ...);
+			}, ops);
+			return p;
+		}
+
+		constexpr Voxel operator()(const Coord coord) const {
+			return sampler(apply(coord));
+		}
+
+		// nullopt stays unknown, an empty box stays empty, a transform without a preimage loses track
+		[[nodiscard]] static constexpr std::optional<Bounds> preimage(const auto& op, const std::optional<Bounds>& box) {
+			if (!box || support_detail::is_empty(*box)) return box;
+			if constexpr (requires { { op.preimage(*box) } -> std::convertible_to<Bounds>; }) return op.preimage(*box);
+			else return std::nullopt;
+		}
+
+		// the sampler's support carried back through the chain, last transform first
+		[[nodiscard]] constexpr std::optional<Bounds> support() const {
+			std::optional<Bounds> box = vox::support(sampler);
+			[&]<std::size_t... I>(std::index_sequence<I...>) {
+				((box = preimage(std::get<sizeof...(Ops) - 1 - I>(ops), box)), ...);
+			}(std::index_sequence_for<Ops...>{});
+			return box;
+		}
+
+		constexpr void sample_row(const Coord start, const std::span<Voxel> out) const {
+			std::array<Coord, row_block> points;
+			for (std::size_t from = 0; from < out.size(); from += row_block) {
+				const std::size_t count = std::min(row_block, out.size() - from);
+				for (std::size_t i = 0; i < count; ++i) {
+					points[i] = apply(Coord(start.x + static_cast<int>(from + i), start.y, start.z));
+				}
+
+				for (std::size_t run = 0; run < count;) {
+					std::size_t end = run + 1;
+					while (end < count && points[end] == points[end - 1] + Coord(1, 0, 0)) ++end;
+					vox::sample_row(sampler, points[run], out.subspan(from + run, end - run));
+					run = end;
+				}
+			}
+		}
+	};
+
 	template<typename... Ops>
 	struct transformer {
 		std::tuple<Ops...> ops;
@@ -40,14 +108,7 @@ namespace vox {
 		template<VoxelSampler S>
 		requires (!Transformer<S>)
 		constexpr auto operator<<(const S& sampler) const {
-			auto ops_copy = ops;
-			return [ops_copy, &sampler](const Coord coord) {
-				Coord p = coord;
-				std::apply([&](const auto&... op) {
-					((p = op(p)), ...);
-				}, ops_copy);
-				return sampler(p);
-			};
+			return transformed<S, Ops...>{ops, sampler};
 		}
 	};
 
@@ -64,19 +125,60 @@ namespace vox {
 		}
 	};
 
+	namespace transform_detail {
+		// a preimage past the edge of the int range is clamped to it, which only ever makes it more conservative
+		[[nodiscard]] constexpr Coord saturate(const double x, const double y, const double z) {
+			constexpr double low = std::numeric_limits<int>::min();
+			constexpr double high = std::numeric_limits<int>::max();
+			return {static_cast<int>(std::clamp(x, low, high)), static_cast<int>(std::clamp(y, low, high)), static_cast<int>(std::clamp(z, low, high))};
+		}
+
+		[[nodiscard]] constexpr Coord saturate(const glm::dvec3 point) {
+			return saturate(point.x, point.y, point.z);
+		}
+	}
+
 	[[nodiscard]] constexpr auto translate(const Coord translation) {
 		return transform_op {
 		[=](const Coord coord) {
 				return coord + translation;
+			},
+		[=](const Bounds& box) {
+				return Bounds{
+					transform_detail::saturate(glm::dvec3(box.from) - glm::dvec3(translation)),
+					transform_detail::saturate(glm::dvec3(box.to) - glm::dvec3(translation))
+				};
 			}
 		};
 	}
 
+	namespace transform_detail {
+		// Transforms below truncate, so a result in [from, to] comes from a point in (from - 1, to + 1)
+		// and box is grown by one before its corners go through the inverse
+		[[nodiscard]] inline Bounds preimage(const Bounds& box, const auto inverse) {
+			const glm::vec3 from = glm::vec3(box.from) - glm::vec3(1.0f);
+			const glm::vec3 to = glm::vec3(box.to) + glm::vec3(1.0f);
+			glm::vec3 low(std::numeric_limits<float>::max());
+			glm::vec3 high(std::numeric_limits<float>::lowest());
+			for (int corner = 0; corner < 8; ++corner) {
+				const glm::vec3 point(corner & 1 ? to.x : from.x, corner & 2 ? to.y : from.y, corner & 4 ? to.z : from.z);
+				const glm::vec3 mapped = inverse(point);
+				low = glm::min(low, mapped);
+				high = glm::max(high, mapped);
+			}
+			// floor and ceil keep the box conservative, the extra voxel absorbs rounding in the inverse
+			return {saturate(glm::dvec3(glm::floor(low)) - 1.0), saturate(glm::dvec3(glm::ceil(high)) + 1.0)};
+		}
+	}
+
 	[[nodiscard]] constexpr auto scale(const glm::vec3 scale) {
 		const auto inv_scale = 1.0f / scale;
 		return transform_op {
 		[=](const Coord coord) {
 				return Coord(glm::vec3(coord) * inv_scale);
+			},
+		[=](const Bounds& box) {
+				return transform_detail::preimage(box, [&](const glm::vec3 point) { return point * scale; });
 			}
 		};
 	}
@@ -85,6 +187,10 @@ namespace vox {
 		return transform_op {
 		[=](const Coord coord) {
 				return Coord(rotation * glm::vec3(coord));
+			},
+		[=](const Bounds& box) {
+				// v * q rotates by the inverse of q
+				return transform_detail::preimage(box, [&](const glm::vec3 point) { return point * rotation; });
 			}
 		};
 	}
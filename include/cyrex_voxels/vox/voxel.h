@@ -5,7 +5,13 @@
 #ifndef VOXEL_GAME_VOXEL_H
 #define VOXEL_GAME_VOXEL_H
 
+#include <algorithm>
+#include <array>
 #include <concepts>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <glm/common.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 
@@ -31,6 +37,114 @@ namespace vox {
     template<typename Sampler>
     concept VoxelSampler = Voxel<std::invoke_result_t<Sampler, Coord>>;
 
+    // A sampler that can also fill a run of voxels along x in one call, which lets it hoist work
+    // shared by the whole row and keeps the per voxel loop free of calls
+    // Usage: sampler.sample_row(start, out) writes sampler(start + Coord(i, 0, 0)) to out[i]
+    template<typename Sampler>
+    concept RowSampler =
+     VoxelSampler<Sampler> &&
+     requires(const Sampler& sampler, Coord start, std::span<std::invoke_result_t<Sampler, Coord>> out)
+    {
+        sampler.sample_row(start, out);
+    };
+
+    // Axes a sampler's result does not depend on, e.g. y for a heightmap or x and z for strata.
+    // Declared as a static member: static constexpr Axes invariant{.y = true};
+    struct Axes {
+        bool x{};
+        bool y{};
+        bool z{};
+    };
+
+    // Axes that neither of two samplers depends on, for combinators of both
+    [[nodiscard]] constexpr Axes common_axes(const Axes& lhs, const Axes& rhs) {
+        return {lhs.x && rhs.x, lhs.y && rhs.y, lhs.z && rhs.z};
+    }
+
+    template<typename Sampler>
+    [[nodiscard]] constexpr Axes invariant_axes() {
+        if constexpr (requires { { Sampler::invariant } -> std::convertible_to<Axes>; }) return Sampler::invariant;
+        else return {};
+    }
+
+    // A sampler that can fill several rows of one z slice at once, so work shared between the rows
+    // (a column lookup, a height) is done once per column instead of once per voxel
+    // Usage: sampler.sample_slice(start, width, out) writes sampler(start + Coord(i, j, 0)) to out[i + width * j]
+    // for out.size() / width rows
+    template<typename Sampler>
+    concept SliceSampler =
+     VoxelSampler<Sampler> &&
+     requires(const Sampler& sampler, Coord start, int width, std::span<std::invoke_result_t<Sampler, Coord>> out)
+    {
+        sampler.sample_slice(start, width, out);
+    };
+
+    // Whether sample_slice does better than one row at a time for this sampler
+    template<typename Sampler>
+    constexpr bool hoists_slices = SliceSampler<Sampler> || invariant_axes<Sampler>().x || invariant_axes<Sampler>().y;
+
+    // Combinators that need scratch space for a row work through it this many voxels at a time
+    constexpr std::size_t row_block = 64;
+
+    // Combinators that need scratch space for part of a z slice take at most this many voxels at a time
+    constexpr std::size_t slice_block = row_block * 16;
+
+    // Splits rows rows of width voxels from start into pieces of at most capacity voxels, in order:
+    // as many whole rows at once as fit, or runs along a single row when even one row does not fit.
+    // Calls fn(offset, piece_start, piece_width, piece_rows) where offset is the piece's first index in the slice
+    constexpr void each_slice_piece(const Coord start, const int width, const int rows, const std::size_t capacity, auto fn) {
+        if (width <= 0 || rows <= 0 || capacity == 0) return;
+        if (static_cast<std::size_t>(width) <= capacity) {
+            const int step = static_cast<int>(std::min<std::size_t>(capacity / width, rows));
+            for (int y = 0; y < rows; y += step) {
+                fn(static_cast<std::size_t>(width) * y, Coord(start.x, start.y + y, start.z), width, std::min(step, rows - y));
+            }
+        } else {
+            const int step = static_cast<int>(capacity);
+            for (int y = 0; y < rows; y++) {
+                for (int x = 0; x < width; x += step) {
+                    fn(static_cast<std::size_t>(width) * y + x, Coord(start.x + x, start.y + y, start.z), std::min(step, width - x), 1);
+                }
+            }
+        }
+    }
+
+    // Fills out from start along x, one call per voxel for samplers without sample_row
+    template<VoxelSampler Sampler>
+    constexpr void sample_row(const Sampler& sampler, const Coord start, const std::span<std::invoke_result_t<Sampler, Coord>> out) {
+        if constexpr (RowSampler<Sampler>) {
+            sampler.sample_row(start, out);
+        } else if constexpr (invariant_axes<Sampler>().x) {
+            if (out.empty()) return;
+            const auto voxel = sampler(start);
+            for (auto& each : out) each = voxel;
+        } else {
+            for (std::size_t i = 0; i < out.size(); i++) {
+                out[i] = sampler(Coord(start.x + static_cast<int>(i), start.y, start.z));
+            }
+        }
+    }
+
+    // Fills rows of width voxels from start up along y, out.size() / width of them.
+    // Samplers without sample_slice go row by row, and one that ignores y is only sampled for the first row.
+    template<VoxelSampler Sampler>
+    constexpr void sample_slice(const Sampler& sampler, const Coord start, const int width, const std::span<std::invoke_result_t<Sampler, Coord>> out) {
+        if (width <= 0) return;
+        if constexpr (SliceSampler<Sampler>) {
+            sampler.sample_slice(start, width, out);
+        } else {
+            const std::size_t rows = out.size() / width;
+            for (std::size_t y = 0; y < rows; y++) {
+                const auto row = out.subspan(y * width, width);
+                if (invariant_axes<Sampler>().y && y > 0) {
+                    std::copy(out.begin(), out.begin() + width, row.begin());
+                } else {
+                    sample_row(sampler, Coord(start.x, start.y + static_cast<int>(y), start.z), row);
+                }
+            }
+        }
+    }
+
     struct VoxelMesh {
         struct Vertex {
             // FIXME: we do not need vec3s
@@ -122,6 +236,48 @@ namespace vox {
         };
     }
 
+    // A sampler that knows where it can return anything but Voxel{}, so callers can skip the rest
+    // Usage: sampler.support() -> std::optional<Bounds>, nullopt when it could be anywhere
+    template<typename Sampler>
+    concept SupportedSampler =
+     VoxelSampler<Sampler> &&
+     requires(const Sampler& sampler)
+    {
+        { sampler.support() } -> std::same_as<std::optional<Bounds>>;
+    };
+
+    // Supports are conservative boxes: nullopt is everywhere, and a box empty on some axis is nowhere
+    namespace support_detail {
+        [[nodiscard]] constexpr bool is_empty(const Bounds& box) {
+            return box.from.x > box.to.x || box.from.y > box.to.y || box.from.z > box.to.z;
+        }
+
+        [[nodiscard]] constexpr std::optional<Bounds> intersect(const std::optional<Bounds>& a, const std::optional<Bounds>& b) {
+            if (!a) return b;
+            if (!b) return a;
+            return Bounds{glm::max(a->from, b->from), glm::min(a->to, b->to)};
+        }
+
+        [[nodiscard]] constexpr std::optional<Bounds> unite(const std::optional<Bounds>& a, const std::optional<Bounds>& b) {
+            if (!a || !b) return std::nullopt;
+            if (is_empty(*a)) return b;
+            if (is_empty(*b)) return a;
+            return Bounds{glm::min(a->from, b->from), glm::max(a->to, b->to)};
+        }
+    }
+
+    template<VoxelSampler Sampler>
+    [[nodiscard]] constexpr std::optional<Bounds> support(const Sampler& sampler) {
+        if constexpr (SupportedSampler<Sampler>) return sampler.support();
+        else return std::nullopt;
+    }
+
+    // The part of bounds where the sampler can return anything, empty if it provably returns Voxel{} throughout
+    template<VoxelSampler Sampler>
+    [[nodiscard]] constexpr Bounds clip_to_support(const Bounds& bounds, const Sampler& sampler) {
+        return *support_detail::intersect(bounds, support(sampler));
+    }
+
     constexpr void each(const Bounds& bounds, auto fn) {
         for (int z = bounds.from.z; z <= bounds.to.z; z++) {
             for (int y = bounds.from.y; y <= bounds.to.y; y++) {
@@ -132,15 +288,25 @@ namespace vox {
         }
     }
 
+    // Same order as each(), but the voxels are sampled a row at a time, or several rows of a z slice at a time
+    // for samplers that share work between rows
     template<VoxelSampler Sampler>
     constexpr void sample_each(const Bounds& bounds, const Sampler& sampler, auto fn) {
+        using Voxel = std::invoke_result_t<Sampler, Coord>;
+        const Coord size = bounds.size();
+
+        std::array<Voxel, hoists_slices<Sampler> ? slice_block : row_block> buffer;
         for (int z = bounds.from.z; z <= bounds.to.z; z++) {
-            for (int y = bounds.from.y; y <= bounds.to.y; y++) {
-                for (int x = bounds.from.x; x <= bounds.to.x; x++) {
-                    const Coord p(x,y,z);
-                    fn(p, sampler(p));
-                }
-            }
+            each_slice_piece(Coord(bounds.from.x, bounds.from.y, z), size.x, size.y, buffer.size(),
+                [&](std::size_t, const Coord start, const int width, const int rows) {
+                    const auto out = std::span(buffer).first(static_cast<std::size_t>(width) * rows);
+                    sample_slice(sampler, start, width, out);
+                    for (int j = 0; j < rows; j++) {
+                        for (int x = 0; x < width; x++) {
+                            fn(Coord(start.x + x, start.y + j, z), out[x + static_cast<std::size_t>(width) * j]);
+                        }
+                    }
+                });
         }
     }
 
@@ -28,7 +28,14 @@
 
 #include <glm/gtx/hash.hpp>
 
+// bakes are region files, which are POSIX only for now
+#if defined(__unix__) || defined(__APPLE__)
+#include "cyrex_voxels/vox/bake.h"
+#define CYREX_VOXELS_BAKE 1
+#endif
 #include "cyrex_voxels/vox/cache.h"
+#include "cyrex_voxels/vox/chunk.h"
+#include "cyrex_voxels/vox/heightfield.h"
 #include "cyrex_voxels/vox/marching.h"
 
 constexpr std::string_view test_vertex_source = R"(
@@ -144,56 +151,134 @@ struct vox::voxel_mesh_traits<TerrainVoxel> {
 
 #include <chrono>
 
-constexpr static vox::VoxelMesh test() {
+// Times both meshers over the scene stored in each flat_cache layout
+static void bench_layouts(const vox::VoxelSampler auto& sampler, const vox::Bounds& bounds) {
+    using namespace vox;
+    using clock = std::chrono::high_resolution_clock;
+
+    const auto elapsed = [](const auto start) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
+    };
+
+    const auto bench = [&]<typename Layout>(const std::string_view name) {
+        const auto cache = flat_cache<Layout>(sampler, bounds, default_thread_count());
+
+        const auto blocky_start = clock::now();
+        const auto blocky = make_blocky_mesher(cache)(bounds);
+        const auto blocky_time = elapsed(blocky_start);
+
+        const auto marching_start = clock::now();
+        const auto marching = make_marching_mesher(cache)(bounds);
+        const auto marching_time = elapsed(marching_start);
+
+        std::cout << name << ": blocky " << blocky_time << " ms (" << blocky.vertices.size() << " vertices), "
+                  << "marching " << marching_time << " ms (" << marching.vertices.size() << " vertices)\n";
+    };
+
+    bench.template operator()<layout::Linear>("linear");
+    bench.template operator()<layout::Bricked<4>>("bricked 4");
+    bench.template operator()<layout::Bricked<8>>("bricked 8");
+    bench.template operator()<layout::Morton<>>("morton 16");
+}
+
+// bake_directory: where to keep generated worlds between runs, empty to always generate
+constexpr static vox::VoxelMesh test(const bool benchmark, const std::string_view bake_directory) {
     using namespace vox;
 
     const int size = 256;
+    // everything the world depends on, so changing any of it misses the bake
+    constexpr float noise_scale = 0.0125f;
+    constexpr float height_scale = 30.0f;
+    constexpr int sand_level = -8;
+    constexpr int cutout_radius = 10;
 
     constexpr auto world_bounds = Bounds{
         .from = {-size, -64, -size},
         .to   = {size, 64, size},
     };
 
-    const auto heightmap = flat_cache([&](const Coord coord) {
-        return 0.5f + 0.5f * glm::perlin(glm::vec2(coord.x, coord.z) * 0.0125f) * 30.0f;
-    }, {{-size, 0, -size}, {size, 0, size}});
-
-    const auto sphere_cutout = flat_cache(sphere(Coord(), 10), cube_bounds(20));
-
-    const auto cut = [](const auto left, const auto right) {
-        return [=](const Coord& coord) {
-            const auto a = left(coord);
-            const auto b = right(coord);
-            if (b) return decltype(a){};
-            return a;
-        };
+    const auto generate = [&] {
+        // plain noise, so the rows can be filled from every thread
+        const auto heightmap = heightfield_cache([&](const Coord coord) {
+            return 0.5f + 0.5f * glm::perlin(glm::vec2(coord.x, coord.z) * noise_scale) * height_scale;
+        }, {{-size, 0, -size}, {size, 0, size}}, default_thread_count());
+
+        const auto sphere_cutout = flat_cache(sphere(Coord(), cutout_radius), cube_bounds(cutout_radius * 2));
+
+        // the height is looked up once per column of a slice rather than for every voxel
+        const auto terrain_sampler = columns(heightmap, [](const float height, const Coord coord) {
+            const int diff = coord.y - height;
+            if (diff > 0) return TerrainVoxel::None;
+            if (diff == 0) { return coord.y < sand_level ? TerrainVoxel::Sand : TerrainVoxel::Grass; }
+            return TerrainVoxel::Dirt;
+        });
+
+        const auto cutout_sampler = chunked_cache(
+            transform{}
+            // << translate({10, 0, 0})
+            // << repeat({50, 0, 50})
+            << sphere_cutout,
+            world_bounds);
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        // only reads the heightmap and the cutout cache, so it can be sampled from every thread
+        auto big_cache = flat_cache(carve(terrain_sampler, cutout_sampler), world_bounds, default_thread_count());
+        const auto end = std::chrono::high_resolution_clock::now();
+        const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+
+        std::cout << "big_cache build time: " << duration.count() << " ms on " << default_thread_count() << " threads\n";
+
+        if (benchmark) {
+            bench_layouts(carve(terrain_sampler, cutout_sampler), world_bounds);
+        }
+        return big_cache;
     };
 
-    const auto terrain_sampler = [&](const Coord coord) {
-        const int diff = coord.y - heightmap(Coord(coord.x, 0, coord.z));
-        if (diff > 0) return TerrainVoxel::None;
-        if (diff == 0) { return coord.y < -8 ? TerrainVoxel::Sand : TerrainVoxel::Grass; }
-        return TerrainVoxel::Dirt;
+    const auto mesh = [&](const auto& sampler) {
+        const auto pyramid = occupancy_pyramid(sampler, world_bounds);
+        const auto mesher = make_marching_mesher(sampler, pyramid);
+        return mesher(world_bounds);
     };
 
-    const auto cutout_sampler = flat_cache(
-        transform{}
-        // << translate({10, 0, 0})
-        // << repeat({50, 0, 50})
-        << sphere_cutout,
-        world_bounds);
-
-    const auto start = std::chrono::high_resolution_clock::now();
-    const auto big_cache = flat_cache(cut(terrain_sampler, cutout_sampler), world_bounds);
-    const auto end = std::chrono::high_resolution_clock::now();
-    const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-
-    std::cout << "big_cache build time: " << duration.count() << " ms\n";
-    const auto mesher = make_marching_mesher(big_cache);
-    return mesher(world_bounds);
+#ifdef CYREX_VOXELS_BAKE
+    if (!bake_directory.empty()) {
+        const auto key = bake_key<TerrainVoxel>(world_bounds, "terrain", noise_scale, height_scale, sand_level, "sphere cutout", cutout_radius);
+        const auto start = std::chrono::high_resolution_clock::now();
+        // generate() returns a flat_cache, which every thread can read
+        auto baked = bake(bake_directory, key, world_bounds, generate, mesh, default_thread_count());
+        const auto end = std::chrono::high_resolution_clock::now();
+        const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+
+        if (baked) {
+            std::cout << (baked->hit ? "loaded bake in " : "baked in ") << duration.count() << " ms\n";
+            return std::move(baked->mesh);
+        }
+        std::cerr << baked.error() << ", generating without it\n";
+    }
+#endif
+
+    return mesh(generate());
 }
 
-int main() {
+int main(int argc, char** argv) {
+    bool benchmark = false;
+    std::string_view bake_directory;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--bench") benchmark = true;
+#ifdef CYREX_VOXELS_BAKE
+        else if (arg == "--bake" && i + 1 < argc) bake_directory = argv[++i];
+#endif
+        else {
+            std::cerr << "usage: " << argv[0] << " [--bench]"
+#ifdef CYREX_VOXELS_BAKE
+                << " [--bake <directory>]"
+#endif
+                << '\n';
+            return 1;
+        }
+    }
+
     using namespace gl;
     if (!glfwInit()) return 1;
     GLFWwindow* window = glfwCreateWindow(1920, 1080, "Hello World", nullptr, nullptr);
@@ -214,7 +299,7 @@ int main() {
 
     gfx::Shader::bind(*program);
 
-    const auto& [vertices, indices] = test();
+    const auto& [vertices, indices] = test(benchmark, bake_directory);
     const auto vbo = gfx::VertexBuffer::make_fixed(std::span(vertices));
     const auto ibo = gfx::IndexBuffer::make_fixed(std::span(indices));
     const auto vao = gfx::VertexArray::make_voxel(vbo, ibo);
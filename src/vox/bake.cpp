@@ -0,0 +1,87 @@
+//
+// Bake file checks and mesh reading and writing
+
+#include <cyrex_voxels/vox/bake.h>
+
+#include <cerrno>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Layout, all native endian: Header, then the vertices, then the indices, both as raw arrays
+namespace {
+	constexpr std::array<char, 8> magic{'C', 'Y', 'M', 'E', 'S', 'H', 0, 0};
+	constexpr std::uint32_t version = 1;
+
+	struct Header {
+		std::array<char, 8> magic;
+		std::uint32_t version;
+		std::uint32_t vertex_size;
+		std::uint64_t vertex_count;
+		std::uint64_t index_count;
+	};
+}
+
+std::expected<void, vox::RegionError> vox::bake_detail::check_directory(const std::string_view directory) {
+	const std::string name(directory);
+	struct stat info{};
+	if (::stat(name.c_str(), &info) != 0) return std::unexpected(region_detail::make_error(directory, "stat"));
+	if (!S_ISDIR(info.st_mode)) return std::unexpected(RegionError{name, "not a directory", ENOTDIR});
+	if (::access(name.c_str(), W_OK | X_OK) != 0) return std::unexpected(region_detail::make_error(directory, "access"));
+	return {};
+}
+
+std::expected<void, vox::RegionError> vox::bake_detail::save_mesh(const std::string_view path, const VoxelMesh& mesh) {
+	auto output = OutputFile::create(path);
+	if (!output) return std::unexpected(output.error());
+
+	const Header header{
+		.magic = magic,
+		.version = version,
+		.vertex_size = sizeof(VoxelMesh::Vertex),
+		.vertex_count = mesh.vertices.size(),
+		.index_count = mesh.indices.size()
+	};
+	if (auto written = output->append(region_detail::as_bytes(header)); !written) return written;
+	if (auto written = output->append(std::as_bytes(std::span(mesh.vertices))); !written) return written;
+	if (auto written = output->append(std::as_bytes(std::span(mesh.indices))); !written) return written;
+	return output->finish();
+}
+
+std::expected<vox::VoxelMesh, vox::RegionError> vox::bake_detail::load_mesh(const std::string_view path) {
+	auto mapped = MappedFile::open(path);
+	if (!mapped) return std::unexpected(mapped.error());
+
+	const auto fail = [&](const std::string_view message) {
+		return std::unexpected(RegionError{std::string(path), std::string(message), 0});
+	};
+
+	const std::span<const std::byte> bytes = mapped->bytes();
+	if (bytes.size() < sizeof(Header)) return fail("too small to be a mesh file");
+
+	Header header;
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	if (header.magic != magic) return fail("not a mesh file");
+	if (header.version != version) return fail("unsupported mesh file version");
+	if (header.vertex_size != sizeof(VoxelMesh::Vertex)) return fail("vertex size does not match");
+
+	const std::span<const std::byte> payload = bytes.subspan(sizeof(Header));
+	if (payload.size() / sizeof(VoxelMesh::Vertex) < header.vertex_count) return fail("vertices are truncated");
+	const std::span<const std::byte> vertices = payload.first(header.vertex_count * sizeof(VoxelMesh::Vertex));
+	const std::span<const std::byte> indices = payload.subspan(vertices.size());
+	// divided rather than multiplied, a corrupt count must not wrap around to a plausible size
+	if (indices.size() % sizeof(unsigned int) != 0 || indices.size() / sizeof(unsigned int) != header.index_count) {
+		return fail("indices are truncated");
+	}
+
+	VoxelMesh mesh;
+	mesh.vertices.resize(header.vertex_count);
+	mesh.indices.resize(header.index_count);
+	std::memcpy(mesh.vertices.data(), vertices.data(), vertices.size());
+	std::memcpy(mesh.indices.data(), indices.data(), indices.size());
+
+	for (const unsigned int index : mesh.indices) {
+		if (index >= mesh.vertices.size()) return fail("index points past the vertices");
+	}
+	return mesh;
+}
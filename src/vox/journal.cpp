@@ -0,0 +1,107 @@
+//
+// Journal file IO: opening, appending and syncing
+
+#include <cyrex_voxels/vox/journal.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using vox::region_detail::make_error;
+
+// reflected IEEE polynomial, the same CRC-32 as zlib
+static constexpr std::array<std::uint32_t, 256> crc_table = [] {
+	std::array<std::uint32_t, 256> table{};
+	for (std::uint32_t i = 0; i < 256; ++i) {
+		std::uint32_t crc = i;
+		for (int bit = 0; bit < 8; ++bit) {
+			crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+		}
+		table[i] = crc;
+	}
+	return table;
+}();
+
+std::uint32_t vox::journal_detail::crc32(const std::span<const std::byte> bytes, std::uint32_t crc) {
+	crc = ~crc;
+	for (const std::byte byte : bytes) {
+		crc = crc_table[(crc ^ static_cast<std::uint32_t>(byte)) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+bool vox::journal_detail::exists(const std::string_view path) {
+	struct stat info{};
+	return ::stat(std::string(path).c_str(), &info) == 0;
+}
+
+std::expected<void, vox::RegionError> vox::journal_detail::rename(const std::string_view from, const std::string_view to) {
+	if (::rename(std::string(from).c_str(), std::string(to).c_str()) != 0) return std::unexpected(make_error(from, "rename"));
+	return {};
+}
+
+std::expected<void, vox::RegionError> vox::journal_detail::remove(const std::string_view path) {
+	if (::unlink(std::string(path).c_str()) != 0) return std::unexpected(make_error(path, "unlink"));
+	return {};
+}
+
+std::expected<vox::AppendFile, vox::RegionError> vox::AppendFile::open(const std::string_view path) {
+	std::string name(path);
+	const int descriptor = ::open(name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (descriptor < 0) return std::unexpected(make_error(path, "open"));
+
+	struct stat info{};
+	if (::fstat(descriptor, &info) != 0) {
+		const auto error = make_error(path, "fstat");
+		::close(descriptor);
+		return std::unexpected(error);
+	}
+	return AppendFile(std::move(name), descriptor, static_cast<std::uint64_t>(info.st_size));
+}
+
+std::expected<void, vox::RegionError> vox::AppendFile::append(std::span<const std::byte> bytes) {
+	while (!bytes.empty()) {
+		const ssize_t count = ::write(descriptor, bytes.data(), bytes.size());
+		if (count < 0) {
+			if (errno == EINTR) continue;
+			return std::unexpected(make_error(path, "write"));
+		}
+		bytes = bytes.subspan(count);
+		length += count;
+	}
+	return {};
+}
+
+std::expected<void, vox::RegionError> vox::AppendFile::truncate(const std::uint64_t size) {
+	if (::ftruncate(descriptor, static_cast<off_t>(size)) != 0) return std::unexpected(make_error(path, "ftruncate"));
+	length = size;
+	return {};
+}
+
+std::expected<void, vox::RegionError> vox::AppendFile::sync() {
+	if (::fdatasync(descriptor) != 0) return std::unexpected(make_error(path, "fdatasync"));
+	return {};
+}
+
+vox::AppendFile::~AppendFile() {
+	if (descriptor >= 0) ::close(descriptor);
+}
+
+vox::AppendFile::AppendFile(AppendFile&& temp) noexcept :
+	path(std::move(temp.path)), descriptor(temp.descriptor), length(temp.length) {
+	temp.descriptor = -1;
+}
+
+vox::AppendFile& vox::AppendFile::operator=(AppendFile&& temp) noexcept {
+	if (this == &temp) return *this;
+	if (descriptor >= 0) ::close(descriptor);
+	path = std::move(temp.path);
+	descriptor = temp.descriptor;
+	length = temp.length;
+	temp.descriptor = -1;
+	return *this;
+}
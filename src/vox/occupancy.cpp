@@ -0,0 +1,153 @@
+//
+// Occupancy mask construction and region queries
+
+#include <cyrex_voxels/vox/occupancy.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+// bits [from, to] of a word set, 0 <= from <= to < 64
+[[nodiscard]] static std::uint64_t bit_range(const int from, const int to) {
+	const std::uint64_t upper = to == 63 ? ~std::uint64_t{0} : (std::uint64_t{1} << (to + 1)) - 1;
+	return upper & (~std::uint64_t{0} << from);
+}
+
+[[nodiscard]] static vox::Bounds clip(const vox::Bounds& box, const vox::Bounds& bounds) {
+	return {glm::max(box.from, bounds.from), glm::min(box.to, bounds.to)};
+}
+
+[[nodiscard]] static bool is_empty(const vox::Bounds& box) {
+	return box.from.x > box.to.x || box.from.y > box.to.y || box.from.z > box.to.z;
+}
+
+std::size_t vox::Occupancy::row_index(const int y, const int z) const noexcept {
+	const Coord size = bounds.size();
+	return static_cast<std::size_t>(words_per_row) *
+		((y - bounds.from.y) + static_cast<std::size_t>(size.y) * (z - bounds.from.z));
+}
+
+bool vox::Occupancy::operator()(const Coord coord) const noexcept {
+	if (!bounds.contains(coord)) return false;
+	const int bit = coord.x - bounds.from.x;
+	return (words[row_index(coord.y, coord.z) + bit / 64] >> (bit % 64)) & 1;
+}
+
+std::size_t vox::Occupancy::count_row(const std::size_t row, const int x0, const int x1) const noexcept {
+	const int first_bit = x0 - bounds.from.x;
+	const int last_bit = x1 - bounds.from.x;
+	const int first_word = first_bit / 64;
+	const int last_word = last_bit / 64;
+	const std::uint64_t* data = &words[row];
+
+	if (first_word == last_word) {
+		return std::popcount(data[first_word] & bit_range(first_bit % 64, last_bit % 64));
+	}
+
+	std::size_t total = std::popcount(data[first_word] & bit_range(first_bit % 64, 63));
+	for (int word = first_word + 1; word < last_word; ++word) {
+		total += std::popcount(data[word]);
+	}
+	total += std::popcount(data[last_word] & bit_range(0, last_bit % 64));
+	return total;
+}
+
+std::size_t vox::Occupancy::count(const Bounds& box) const noexcept {
+	const Bounds clipped = clip(box, bounds);
+	if (is_empty(clipped)) return 0;
+
+	std::size_t total = 0;
+	for (int z = clipped.from.z; z <= clipped.to.z; ++z) {
+		for (int y = clipped.from.y; y <= clipped.to.y; ++y) {
+			total += count_row(row_index(y, z), clipped.from.x, clipped.to.x);
+		}
+	}
+	return total;
+}
+
+std::size_t vox::Occupancy::count(const Coord centre, const float radius) const noexcept {
+	const int reach = static_cast<int>(std::floor(radius));
+	const Bounds clipped = clip({centre - Coord(reach), centre + Coord(reach)}, bounds);
+	if (is_empty(clipped)) return 0;
+
+	const float radius_squared = radius * radius;
+	std::size_t total = 0;
+
+	// each row of a sphere is a single x span
+	for (int z = clipped.from.z; z <= clipped.to.z; ++z) {
+		for (int y = clipped.from.y; y <= clipped.to.y; ++y) {
+			const float dy = static_cast<float>(y - centre.y);
+			const float dz = static_cast<float>(z - centre.z);
+			const float remaining = radius_squared - dy * dy - dz * dz;
+			if (remaining < 0.0f) continue;
+
+			const int half_span = static_cast<int>(std::floor(std::sqrt(remaining)));
+			const int x0 = std::max(centre.x - half_span, clipped.from.x);
+			const int x1 = std::min(centre.x + half_span, clipped.to.x);
+			if (x0 > x1) continue;
+			total += count_row(row_index(y, z), x0, x1);
+		}
+	}
+	return total;
+}
+
+vox::Region vox::Occupancy::classify(const Bounds& box) const noexcept {
+	const Bounds clipped = clip(box, bounds);
+	if (is_empty(clipped)) return Region::Empty;
+
+	const auto row_length = static_cast<std::size_t>(clipped.to.x - clipped.from.x + 1);
+	bool any_solid = false;
+	bool any_empty = false;
+
+	for (int z = clipped.from.z; z <= clipped.to.z; ++z) {
+		for (int y = clipped.from.y; y <= clipped.to.y; ++y) {
+			const std::size_t solid = count_row(row_index(y, z), clipped.from.x, clipped.to.x);
+			any_solid = any_solid || solid > 0;
+			any_empty = any_empty || solid < row_length;
+			if (any_solid && any_empty) return Region::Mixed;
+		}
+	}
+	return any_solid ? Region::Full : Region::Empty;
+}
+
+std::optional<vox::Coord> vox::Occupancy::first_solid(const Coord start, const Axis axis, const int direction) const noexcept {
+	// 0 would never leave start, anything else only says which way to walk
+	if (!bounds.contains(start) || direction == 0) return std::nullopt;
+	const int step = std::clamp(direction, -1, 1);
+
+	if (axis != Axis::X) {
+		// rows are not contiguous along y and z, test one bit per step
+		for (Coord p = start; bounds.contains(p); axis == Axis::Y ? p.y += step : p.z += step) {
+			if ((*this)(p)) return p;
+		}
+		return std::nullopt;
+	}
+
+	const std::uint64_t* row = &words[row_index(start.y, start.z)];
+	const int width = bounds.size().x;
+	int bit = start.x - bounds.from.x;
+
+	// scan whole words with a bit scan instead of testing every voxel
+	while (bit >= 0 && bit < width) {
+		const int word = bit / 64;
+		const int offset = bit % 64;
+
+		if (step > 0) {
+			const std::uint64_t masked = row[word] & (~std::uint64_t{0} << offset);
+			if (masked) {
+				const int found = word * 64 + std::countr_zero(masked);
+				if (found >= width) return std::nullopt;
+				return Coord(bounds.from.x + found, start.y, start.z);
+			}
+			bit = (word + 1) * 64;
+		} else {
+			const std::uint64_t masked = row[word] & bit_range(0, offset);
+			if (masked) {
+				const int found = word * 64 + 63 - std::countl_zero(masked);
+				return Coord(bounds.from.x + found, start.y, start.z);
+			}
+			bit = word * 64 - 1;
+		}
+	}
+	return std::nullopt;
+}
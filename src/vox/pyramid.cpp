@@ -0,0 +1,89 @@
+//
+// Occupancy pyramid construction and the block walk
+
+#include <cyrex_voxels/vox/pyramid.h>
+
+#include <algorithm>
+
+[[nodiscard]] static bool encloses(const vox::Bounds& outer, const vox::Bounds& inner) {
+	return outer.contains(inner.from) && outer.contains(inner.to);
+}
+
+vox::OccupancyPyramid::OccupancyPyramid(const Occupancy& occupancy, const int block_size, const int factor) :
+	bounds(occupancy.bounds) {
+	const Coord size = bounds.size();
+
+	// finest level straight from the bit mask
+	{
+		Level level{.block_size = block_size, .blocks = (size + Coord(block_size - 1)) / block_size, .states = {}};
+		level.states.reserve(static_cast<std::size_t>(level.blocks.x) * level.blocks.y * level.blocks.z);
+		each({Coord(0), level.blocks - Coord(1)}, [&](const Coord block) {
+			const Coord from = bounds.from + block * block_size;
+			level.states.push_back(occupancy.classify({from, from + Coord(block_size - 1)}));
+		});
+		levels.push_back(std::move(level));
+	}
+
+	// coarser levels merge factor^3 children until a single block covers everything
+	while (levels.back().blocks != Coord(1)) {
+		const Level& child = levels.back();
+		Level level{.block_size = child.block_size * factor, .blocks = (child.blocks + Coord(factor - 1)) / factor, .states = {}};
+		level.states.reserve(static_cast<std::size_t>(level.blocks.x) * level.blocks.y * level.blocks.z);
+
+		each({Coord(0), level.blocks - Coord(1)}, [&](const Coord block) {
+			const Coord from = block * factor;
+			const Coord to = glm::min(from + Coord(factor - 1), child.blocks - Coord(1));
+			bool any_empty = false;
+			bool any_full = false;
+			each({from, to}, [&](const Coord c) {
+				const Region state = child.at(c);
+				any_empty = any_empty || state != Region::Full;
+				any_full = any_full || state != Region::Empty;
+			});
+			level.states.push_back(any_empty && any_full ? Region::Mixed : any_full ? Region::Full : Region::Empty);
+		});
+		levels.push_back(std::move(level));
+	}
+}
+
+vox::Region vox::OccupancyPyramid::classify(const Bounds& box) const noexcept {
+	if (!encloses(bounds, box)) return Region::Mixed;
+
+	bool any_empty = false;
+	bool any_full = false;
+	classify(levels.size() - 1, Coord(0), box, any_empty, any_full);
+	if (any_empty && any_full) return Region::Mixed;
+	return any_full ? Region::Full : Region::Empty;
+}
+
+void vox::OccupancyPyramid::classify(const std::size_t level, const Coord block, const Bounds& box,
+	bool& any_empty, bool& any_full) const noexcept {
+	if (any_empty && any_full) return;
+
+	const Level& current = levels[level];
+	const Coord from = bounds.from + block * current.block_size;
+	const Bounds region{from, from + Coord(current.block_size - 1)};
+	const Bounds overlap{glm::max(region.from, box.from), glm::min(region.to, box.to)};
+	if (overlap.from.x > overlap.to.x || overlap.from.y > overlap.to.y || overlap.from.z > overlap.to.z) return;
+
+	switch (current.at(block)) {
+		case Region::Empty: any_empty = true; return;
+		case Region::Full: any_full = true; return;
+		case Region::Mixed: break;
+	}
+
+	if (level == 0) {
+		// a mixed block we cannot see into, assume the worst
+		any_empty = true;
+		any_full = true;
+		return;
+	}
+
+	// only visit the children the box actually touches
+	const Level& children = levels[level - 1];
+	const Coord first = (overlap.from - bounds.from) / children.block_size;
+	const Coord last = (overlap.to - bounds.from) / children.block_size;
+	each({first, last}, [&](const Coord child) {
+		classify(level - 1, child, box, any_empty, any_full);
+	});
+}
@@ -0,0 +1,140 @@
+//
+// Region file mapping and the atomic write behind save_region
+
+#include <cyrex_voxels/vox/region.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using vox::region_detail::make_error;
+
+vox::RegionError vox::region_detail::make_error(const std::string_view path, const std::string_view call) {
+	const int code = errno;
+	return {std::string(path), std::string(call) + ": " + std::strerror(code), code};
+}
+
+static std::string temporary_path(const std::string_view path) {
+	return std::string(path) + ".tmp";
+}
+
+std::expected<vox::MappedFile, vox::RegionError> vox::MappedFile::open(const std::string_view path) {
+	const std::string name(path);
+	const int descriptor = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0) return std::unexpected(make_error(path, "open"));
+
+	struct stat info{};
+	if (::fstat(descriptor, &info) != 0) {
+		const auto error = make_error(path, "fstat");
+		::close(descriptor);
+		return std::unexpected(error);
+	}
+
+	const auto size = static_cast<std::size_t>(info.st_size);
+	if (size == 0) {
+		::close(descriptor);
+		return MappedFile(nullptr, 0);
+	}
+
+	void* data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+	// the mapping keeps the file alive on its own
+	::close(descriptor);
+	if (data == MAP_FAILED) return std::unexpected(make_error(path, "mmap"));
+
+	// chunks are looked up all over the place, read ahead would mostly fetch pages nobody asked for
+	::madvise(data, size, MADV_RANDOM);
+	return MappedFile(static_cast<const std::byte*>(data), size);
+}
+
+vox::MappedFile::~MappedFile() {
+	if (data) ::munmap(const_cast<std::byte*>(data), size);
+}
+
+vox::MappedFile::MappedFile(MappedFile&& temp) noexcept : data(temp.data), size(temp.size) {
+	temp.data = nullptr;
+	temp.size = 0;
+}
+
+vox::MappedFile& vox::MappedFile::operator=(MappedFile&& temp) noexcept {
+	if (this == &temp) return *this;
+	if (data) ::munmap(const_cast<std::byte*>(data), size);
+	data = temp.data;
+	size = temp.size;
+	temp.data = nullptr;
+	temp.size = 0;
+	return *this;
+}
+
+std::expected<vox::OutputFile, vox::RegionError> vox::OutputFile::create(const std::string_view path) {
+	const std::string temporary = temporary_path(path);
+	const int descriptor = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (descriptor < 0) return std::unexpected(make_error(temporary, "open"));
+	return OutputFile(std::string(path), descriptor);
+}
+
+std::expected<void, vox::RegionError> vox::OutputFile::append(const std::span<const std::byte> bytes) {
+	return write_at(written, bytes);
+}
+
+std::expected<void, vox::RegionError> vox::OutputFile::write_at(const std::uint64_t offset, std::span<const std::byte> bytes) {
+	std::uint64_t position = offset;
+	while (!bytes.empty()) {
+		const ssize_t count = ::pwrite(descriptor, bytes.data(), bytes.size(), static_cast<off_t>(position));
+		if (count < 0) {
+			if (errno == EINTR) continue;
+			return std::unexpected(make_error(temporary_path(path), "pwrite"));
+		}
+		bytes = bytes.subspan(count);
+		position += count;
+	}
+	written = std::max(written, position);
+	return {};
+}
+
+std::expected<void, vox::RegionError> vox::OutputFile::finish() {
+	const std::string temporary = temporary_path(path);
+	if (::fsync(descriptor) != 0) return std::unexpected(make_error(temporary, "fsync"));
+
+	const int descriptor_to_close = descriptor;
+	descriptor = -1;
+	if (::close(descriptor_to_close) != 0) return std::unexpected(make_error(temporary, "close"));
+	if (::rename(temporary.c_str(), path.c_str()) != 0) return std::unexpected(make_error(path, "rename"));
+	return {};
+}
+
+vox::OutputFile::~OutputFile() {
+	// never finished, throw the partial file away
+	if (descriptor >= 0) {
+		::close(descriptor);
+		::unlink(temporary_path(path).c_str());
+	}
+}
+
+vox::OutputFile::OutputFile(OutputFile&& temp) noexcept :
+	path(std::move(temp.path)), descriptor(temp.descriptor), written(temp.written) {
+	temp.descriptor = -1;
+}
+
+vox::OutputFile& vox::OutputFile::operator=(OutputFile&& temp) noexcept {
+	if (this == &temp) return *this;
+	if (descriptor >= 0) {
+		::close(descriptor);
+		::unlink(temporary_path(path).c_str());
+	}
+	path = std::move(temp.path);
+	descriptor = temp.descriptor;
+	written = temp.written;
+	temp.descriptor = -1;
+	return *this;
+}
+
+std::ostream& vox::operator<<(std::ostream& os, const RegionError& err) {
+	os << "Region file error: " << err.path << ": " << err.message;
+	return os;
+}
@@ -0,0 +1,227 @@
+//
+// Scalar and x86 vector kernels, picked once per process
+
+#include <cyrex_voxels/vox/simd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CYREX_VOXELS_X86 1
+#endif
+
+namespace {
+	using Within = void (*)(float, float, float, bool*, std::size_t);
+	using Combine = void (*)(bool*, const bool*, std::size_t);
+	using Invert = void (*)(bool*, std::size_t);
+
+	struct Kernels {
+		vox::simd::Level level;
+		Within within;
+		Combine and_rows;
+		Combine or_rows;
+		Combine xor_rows;
+		Invert not_row;
+	};
+
+	void within_scalar(const float x, const float rest, const float limit, bool* out, const std::size_t count) {
+		for (std::size_t i = 0; i < count; ++i) {
+			const float offset = x + static_cast<float>(i);
+			out[i] = offset * offset + rest <= limit;
+		}
+	}
+
+	// bools are 0 or 1, so the bitwise ops on their bytes are the logical ones
+	template<typename Op>
+	void combine_scalar(bool* left, const bool* right, const std::size_t count) {
+		for (std::size_t i = 0; i < count; ++i) {
+			left[i] = Op{}(left[i], right[i]);
+		}
+	}
+
+	void not_scalar(bool* row, const std::size_t count) {
+		for (std::size_t i = 0; i < count; ++i) {
+			row[i] = !row[i];
+		}
+	}
+
+	constexpr Kernels scalar{
+		vox::simd::Level::Scalar,
+		within_scalar,
+		combine_scalar<std::bit_and<bool>>,
+		combine_scalar<std::bit_or<bool>>,
+		combine_scalar<std::bit_xor<bool>>,
+		not_scalar
+	};
+
+#ifdef CYREX_VOXELS_X86
+	// 8 mask bits to 8 bytes of 0 or 1
+	[[nodiscard]] std::uint64_t spread_bits(const unsigned bits) {
+		std::uint64_t bytes = bits * 0x0101010101010101ull & 0x8040201008040201ull;
+		// any set bit in a byte carries into its top bit, which then moves down to the bottom one
+		bytes = (bytes + 0x7f7f7f7f7f7f7f7full) >> 7 & 0x0101010101010101ull;
+		return bytes;
+	}
+
+	[[gnu::target("avx2")]] void within_avx2(const float x, const float rest, const float limit, bool* out, const std::size_t count) {
+		const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+		const __m256 rests = _mm256_set1_ps(rest);
+		const __m256 limits = _mm256_set1_ps(limit);
+
+		std::size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m256 offset = _mm256_add_ps(_mm256_set1_ps(x + static_cast<float>(i)), lanes);
+			const __m256 distance = _mm256_add_ps(_mm256_mul_ps(offset, offset), rests);
+			const std::uint64_t bytes = spread_bits(_mm256_movemask_ps(_mm256_cmp_ps(distance, limits, _CMP_LE_OQ)));
+			std::memcpy(out + i, &bytes, sizeof(bytes));
+		}
+		within_scalar(x + static_cast<float>(i), rest, limit, out + i, count - i);
+	}
+
+	template<__m256i (*Op)(__m256i, __m256i), typename Tail>
+	[[gnu::target("avx2")]] void combine_avx2(bool* left, const bool* right, const std::size_t count) {
+		std::size_t i = 0;
+		for (; i + 32 <= count; i += 32) {
+			const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i));
+			const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(left + i), Op(a, b));
+		}
+		combine_scalar<Tail>(left + i, right + i, count - i);
+	}
+
+	[[gnu::target("avx2")]] __m256i and_avx2(const __m256i a, const __m256i b) { return _mm256_and_si256(a, b); }
+	[[gnu::target("avx2")]] __m256i or_avx2(const __m256i a, const __m256i b) { return _mm256_or_si256(a, b); }
+	[[gnu::target("avx2")]] __m256i xor_avx2(const __m256i a, const __m256i b) { return _mm256_xor_si256(a, b); }
+
+	[[gnu::target("avx2")]] void not_avx2(bool* row, const std::size_t count) {
+		const __m256i ones = _mm256_set1_epi8(1);
+		std::size_t i = 0;
+		for (; i + 32 <= count; i += 32) {
+			const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(row + i), _mm256_xor_si256(a, ones));
+		}
+		not_scalar(row + i, count - i);
+	}
+
+	constexpr Kernels avx2{
+		vox::simd::Level::AVX2,
+		within_avx2,
+		combine_avx2<and_avx2, std::bit_and<bool>>,
+		combine_avx2<or_avx2, std::bit_or<bool>>,
+		combine_avx2<xor_avx2, std::bit_xor<bool>>,
+		not_avx2
+	};
+
+#define CYREX_VOXELS_AVX512 gnu::target("avx512f,avx512bw,avx512vl")
+
+	[[CYREX_VOXELS_AVX512]] void within_avx512(const float x, const float rest, const float limit, bool* out, const std::size_t count) {
+		const __m512 lanes = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+		const __m512 rests = _mm512_set1_ps(rest);
+		const __m512 limits = _mm512_set1_ps(limit);
+		const __m128i ones = _mm_set1_epi8(1);
+
+		std::size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const __m512 offset = _mm512_add_ps(_mm512_set1_ps(x + static_cast<float>(i)), lanes);
+			const __m512 distance = _mm512_add_ps(_mm512_mul_ps(offset, offset), rests);
+			const __mmask16 inside = _mm512_cmp_ps_mask(distance, limits, _CMP_LE_OQ);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_maskz_mov_epi8(inside, ones));
+		}
+		within_scalar(x + static_cast<float>(i), rest, limit, out + i, count - i);
+	}
+
+	template<__m512i (*Op)(__m512i, __m512i), typename Tail>
+	[[CYREX_VOXELS_AVX512]] void combine_avx512(bool* left, const bool* right, const std::size_t count) {
+		std::size_t i = 0;
+		for (; i + 64 <= count; i += 64) {
+			const __m512i a = _mm512_loadu_si512(left + i);
+			const __m512i b = _mm512_loadu_si512(right + i);
+			_mm512_storeu_si512(left + i, Op(a, b));
+		}
+		combine_scalar<Tail>(left + i, right + i, count - i);
+	}
+
+	[[CYREX_VOXELS_AVX512]] __m512i and_avx512(const __m512i a, const __m512i b) { return _mm512_and_si512(a, b); }
+	[[CYREX_VOXELS_AVX512]] __m512i or_avx512(const __m512i a, const __m512i b) { return _mm512_or_si512(a, b); }
+	[[CYREX_VOXELS_AVX512]] __m512i xor_avx512(const __m512i a, const __m512i b) { return _mm512_xor_si512(a, b); }
+
+	[[CYREX_VOXELS_AVX512]] void not_avx512(bool* row, const std::size_t count) {
+		const __m512i ones = _mm512_set1_epi8(1);
+		std::size_t i = 0;
+		for (; i + 64 <= count; i += 64) {
+			_mm512_storeu_si512(row + i, _mm512_xor_si512(_mm512_loadu_si512(row + i), ones));
+		}
+		not_scalar(row + i, count - i);
+	}
+
+	constexpr Kernels avx512{
+		vox::simd::Level::AVX512,
+		within_avx512,
+		combine_avx512<and_avx512, std::bit_and<bool>>,
+		combine_avx512<or_avx512, std::bit_or<bool>>,
+		combine_avx512<xor_avx512, std::bit_xor<bool>>,
+		not_avx512
+	};
+
+#undef CYREX_VOXELS_AVX512
+#endif
+
+	// CYREX_VOXELS_SIMD=scalar or =avx2 caps the level, for comparing the paths on one machine
+	[[nodiscard]] const Kernels& pick() {
+		const char* cap = std::getenv("CYREX_VOXELS_SIMD");
+		const std::string_view limit = cap ? cap : "";
+		if (limit == "scalar") return scalar;
+
+#ifdef CYREX_VOXELS_X86
+		__builtin_cpu_init();
+		if (limit != "avx2" && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+			__builtin_cpu_supports("avx512vl")) {
+			return avx512;
+		}
+		if (__builtin_cpu_supports("avx2")) return avx2;
+#endif
+		return scalar;
+	}
+
+	[[nodiscard]] const Kernels& kernels() {
+		static const Kernels& picked = pick();
+		return picked;
+	}
+}
+
+vox::simd::Level vox::simd::level() noexcept {
+	return kernels().level;
+}
+
+const char* vox::simd::name(const Level level) noexcept {
+	switch (level) {
+		case Level::Scalar: return "scalar";
+		case Level::AVX2: return "AVX2";
+		case Level::AVX512: return "AVX-512";
+	}
+	return "unknown";
+}
+
+void vox::simd::within(const float x, const float rest, const float limit, const std::span<bool> out) noexcept {
+	kernels().within(x, rest, limit, out.data(), out.size());
+}
+
+void vox::simd::and_rows(const std::span<bool> left, const std::span<const bool> right) noexcept {
+	kernels().and_rows(left.data(), right.data(), left.size());
+}
+
+void vox::simd::or_rows(const std::span<bool> left, const std::span<const bool> right) noexcept {
+	kernels().or_rows(left.data(), right.data(), left.size());
+}
+
+void vox::simd::xor_rows(const std::span<bool> left, const std::span<const bool> right) noexcept {
+	kernels().xor_rows(left.data(), right.data(), left.size());
+}
+
+void vox::simd::not_row(const std::span<bool> row) noexcept {
+	kernels().not_row(row.data(), row.size());
+}
@@ -0,0 +1,61 @@
+//
+// VoxelDag round trips
+
+#include "test.h"
+#include <cyrex_voxels/vox/dag.h>
+
+using namespace vox;
+using vox_test::Material;
+
+namespace {
+	void cache_round_trip() {
+		for (const unsigned threads : {1u, 4u}) {
+			const auto dag = dag_cache(vox_test::terrain, vox_test::world, threads);
+			int wrong = 0;
+			vox_test::each_around(vox_test::world, [&](const Coord coord) {
+				const Material expected = vox_test::world.contains(coord) ? vox_test::terrain(coord) : Material{};
+				if (!(dag(coord) == expected)) ++wrong;
+			});
+			CHECK(wrong == 0);
+		}
+	}
+
+	// building the subtrees on separate threads shares exactly as much as a single thread does
+	void threads_share_the_same() {
+		const auto one = dag_cache(vox_test::terrain, vox_test::world, 1);
+		const auto many = dag_cache(vox_test::terrain, vox_test::world, 8);
+		CHECK(one.nodes.size() == many.nodes.size());
+		CHECK(one.leaves.size() == many.leaves.size());
+	}
+
+	// a pattern repeated along x is stored once
+	void repeats_are_shared() {
+		const Bounds bounds{Coord(0), Coord(63)};
+		const auto tile = [](const Coord coord) { return Material{static_cast<std::uint8_t>((coord.x % 8 + coord.y % 3 + coord.z % 8) % 5)}; };
+		const auto dag = dag_cache(tile, bounds, 1);
+		int wrong = 0;
+		each(bounds, [&](const Coord coord) {
+			if (!(dag(coord) == tile(coord))) ++wrong;
+		});
+		CHECK(wrong == 0);
+		CHECK(dag.leaves.size() <= 5);
+		CHECK(dag.nodes.size() < 64);
+	}
+
+	// -0 and 0 compare equal, so they must share a leaf rather than hash apart
+	void negative_zero_is_zero() {
+		const Bounds bounds{Coord(0), Coord(15)};
+		const auto signs = [](const Coord coord) { return Color((coord.x + coord.y + coord.z) % 2 ? -0.0f : 0.0f); };
+		const auto dag = dag_cache(signs, bounds, 1);
+		CHECK(dag.leaves.size() == 1);
+		CHECK(dag(Coord(1, 0, 0)) == Color(0.0f));
+	}
+}
+
+int main() {
+	cache_round_trip();
+	threads_share_the_same();
+	repeats_are_shared();
+	negative_zero_is_zero();
+	return vox_test::report();
+}
@@ -0,0 +1,143 @@
+//
+// Journal replay and compaction
+
+#include "test.h"
+#include <cyrex_voxels/vox/journal.h>
+#include <fstream>
+
+using namespace vox;
+using vox_test::Material;
+
+namespace {
+	constexpr int size = 16;
+	using Store = ChunkStore<Material, size>;
+	using Log = Journal<Material, size>;
+
+	[[nodiscard]] int differences(const Store& expected, const Store& actual) {
+		int wrong = 0;
+		vox_test::each_around(vox_test::world, [&](const Coord coord) {
+			if (!(expected(coord) == actual(coord))) ++wrong;
+		});
+		return wrong;
+	}
+
+	// makes a few edits, publishes them and records what changed
+	void edit(Store& store, Log& journal, const int seed) {
+		const auto before = store.snapshot();
+		typename Store::Batch batch;
+		batch.fill(Coord(seed, 0, -seed), 5.0f, Material{static_cast<std::uint8_t>(seed + 4)});
+		batch.fill(Bounds{Coord(-20, -13, seed), Coord(-10, -8, seed + 3)}, Material{});
+		store.apply(batch, 1);
+		store.set(Coord(seed * 3, 15, 7), Material{7});
+		store.publish();
+		CHECK(journal.record(before, store.snapshot()).has_value());
+	}
+
+	void replay_without_base() {
+		const vox_test::TempDirectory directory("cyrex-journal");
+		const std::string base = directory.file("world.region");
+		const std::string path = directory.file("world.journal");
+
+		auto journal = Log::open(path);
+		CHECK(journal.has_value());
+		if (!journal) return;
+		// with no base file the journal is replayed onto an empty world
+		Store empty(vox_test::world);
+		for (int seed = 0; seed < 3; ++seed) edit(empty, *journal, seed * 7);
+
+		const auto replayed = Log::replay(base, path, vox_test::world, 1);
+		CHECK(replayed.has_value());
+		if (replayed) CHECK(differences(empty, *replayed) == 0);
+	}
+
+	void compaction_folds_the_journal() {
+		const vox_test::TempDirectory directory("cyrex-journal-compact");
+		const std::string base = directory.file("world.region");
+		const std::string path = directory.file("world.journal");
+
+		Store store(vox_test::terrain, vox_test::world, 1);
+		CHECK(save_region<size>(base, store.snapshot(), vox_test::world, 1).has_value());
+		auto journal = Log::open(path);
+		CHECK(journal.has_value());
+		if (!journal) return;
+
+		edit(store, *journal, 2);
+		edit(store, *journal, 9);
+		CHECK(journal->size() > sizeof(journal_detail::FileHeader));
+
+		CHECK(journal->compact(store, base, 1).has_value());
+		CHECK(journal->size() == sizeof(journal_detail::FileHeader));
+		CHECK(!journal_detail::exists(journal_detail::sealed_path(path)));
+
+		// the base covers everything so far, the journal only what came after
+		edit(store, *journal, 15);
+		const auto replayed = Log::replay(base, path, vox_test::world, 1);
+		CHECK(replayed.has_value());
+		if (replayed) CHECK(differences(store, *replayed) == 0);
+	}
+
+	// a record torn by a crash is dropped on open and replay sees everything before it
+	void torn_tail_is_cut() {
+		const vox_test::TempDirectory directory("cyrex-journal-torn");
+		const std::string base = directory.file("world.region");
+		const std::string path = directory.file("world.journal");
+
+		Store store(vox_test::terrain, vox_test::world, 1);
+		CHECK(save_region<size>(base, store.snapshot(), vox_test::world, 1).has_value());
+		{
+			auto journal = Log::open(path);
+			CHECK(journal.has_value());
+			if (!journal) return;
+			edit(store, *journal, 4);
+		}
+		const auto intact = std::filesystem::file_size(path);
+		std::ofstream(path, std::ios::binary | std::ios::app) << "half a record";
+
+		auto reopened = Log::open(path);
+		CHECK(reopened.has_value());
+		CHECK(std::filesystem::file_size(path) == intact);
+
+		const auto replayed = Log::replay(base, path, vox_test::world, 1);
+		CHECK(replayed.has_value());
+		if (replayed) CHECK(differences(store, *replayed) == 0);
+	}
+
+	// compact() crashing between creating the new journal and writing its header leaves it empty
+	void empty_journal_has_no_records() {
+		const vox_test::TempDirectory directory("cyrex-journal-empty");
+		const std::string base = directory.file("world.region");
+		const std::string path = directory.file("world.journal");
+
+		Store store(vox_test::terrain, vox_test::world, 1);
+		CHECK(save_region<size>(base, store.snapshot(), vox_test::world, 1).has_value());
+		std::ofstream(path, std::ios::binary).flush();
+		std::ofstream(journal_detail::sealed_path(path), std::ios::binary).flush();
+
+		const auto replayed = Log::replay(base, path, vox_test::world, 1);
+		CHECK(replayed.has_value());
+		if (replayed) CHECK(differences(store, *replayed) == 0);
+
+		// too short to hold a header is not a journal at all
+		std::ofstream(path, std::ios::binary) << "CYJ";
+		CHECK(!Log::replay(base, path, vox_test::world, 1).has_value());
+	}
+
+	void refuses_other_formats() {
+		const vox_test::TempDirectory directory("cyrex-journal-bad");
+		const std::string path = directory.file("world.journal");
+		CHECK(Log::open(path).has_value());
+		CHECK(!Journal<Material, 32>::open(path).has_value());
+
+		std::ofstream(directory.file("text.journal"), std::ios::binary) << "not a journal at all, just text";
+		CHECK(!Log::open(directory.file("text.journal")).has_value());
+	}
+}
+
+int main() {
+	replay_without_base();
+	compaction_folds_the_journal();
+	torn_tail_is_cut();
+	empty_journal_has_no_records();
+	refuses_other_formats();
+	return vox_test::report();
+}
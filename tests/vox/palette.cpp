@@ -0,0 +1,131 @@
+//
+// PaletteChunk and palette_cache round trips
+
+#include "test.h"
+#include <cyrex_voxels/vox/palette.h>
+#include <vector>
+
+using namespace vox;
+using vox_test::Material;
+
+namespace {
+	struct Wide {
+		std::uint16_t id{};
+		[[nodiscard]] constexpr bool operator==(const Wide&) const = default;
+	};
+}
+
+template<>
+struct vox::voxel_mesh_traits<Wide> {
+	[[nodiscard]] static constexpr bool is_visible(const Wide wide) { return wide.id != 0; }
+	[[nodiscard]] static constexpr Color color(Wide, Coord) { return Color(1.0f); }
+};
+
+namespace {
+	constexpr int size = 16;
+
+	// every voxel of the chunk reads back as written, one at a time and decoded in bulk
+	template<typename Voxel>
+	void check_chunk(const PaletteChunk<Voxel, size>& chunk, const std::vector<Voxel>& expected) {
+		std::vector<Voxel> decoded(PaletteChunk<Voxel, size>::volume);
+		chunk.decode(decoded);
+		int wrong = 0;
+		each({Coord(0), Coord(size - 1)}, [&](const Coord local) {
+			const int index = chunk_index<size>(local);
+			if (!(chunk[local] == expected[index]) || !(decoded[index] == expected[index])) ++wrong;
+		});
+		CHECK(wrong == 0);
+	}
+
+	// the index width grows through every step as distinct voxels are written
+	void grows_on_write() {
+		PaletteChunk<Material, size> chunk;
+		std::vector<Material> expected(chunk.volume);
+		CHECK(chunk.is_uniform());
+
+		const int widths[] = {1, 2, 4, 4, 8, 8};
+		const int counts[] = {2, 4, 5, 16, 17, 256};
+		for (int step = 0; step < 6; ++step) {
+			for (int id = 1; id < counts[step]; ++id) {
+				const Coord local(id % size, id / size % size, (id * 7) % size);
+				chunk.set(local, Material{static_cast<std::uint8_t>(id)});
+				expected[chunk_index<size>(local)] = Material{static_cast<std::uint8_t>(id)};
+			}
+			CHECK(chunk.bits == widths[step]);
+			check_chunk(chunk, expected);
+		}
+	}
+
+	void sixteen_bit_indices() {
+		std::vector<Wide> voxels(PaletteChunk<Wide, size>::volume);
+		for (std::size_t i = 0; i < voxels.size(); ++i) voxels[i] = Wide{static_cast<std::uint16_t>(i % 1000)};
+		const auto chunk = PaletteChunk<Wide, size>::encode(voxels);
+		CHECK(chunk.bits == 16);
+		check_chunk(chunk, voxels);
+	}
+
+	// overwriting keeps only the entries still in use, so more distinct writes than a chunk
+	// could ever hold read back intact and the indices stay narrow
+	void overwrites_are_dropped() {
+		PaletteChunk<Wide, size> chunk;
+		std::vector<Wide> expected(chunk.volume);
+		const Coord local(3, 4, 5);
+		for (int write = 1; write <= 70000; ++write) {
+			chunk.set(local, Wide{static_cast<std::uint16_t>(write % 65536 + 1)});
+		}
+		expected[chunk_index<size>(local)] = Wide{70000 % 65536 + 1};
+		CHECK(chunk.bits == 1);
+		CHECK(chunk.palette.size() <= 2);
+		check_chunk(chunk, expected);
+
+		// every voxel different, then every voxel rewritten with values not seen before
+		for (int round = 0; round < 3; ++round) {
+			each({Coord(0), Coord(size - 1)}, [&](const Coord at) {
+				const int index = chunk_index<size>(at);
+				const Wide voxel{static_cast<std::uint16_t>(round * chunk.volume + index + 1)};
+				chunk.set(at, voxel);
+				expected[index] = voxel;
+			});
+			CHECK(chunk.palette.size() <= static_cast<std::size_t>(chunk.volume));
+			check_chunk(chunk, expected);
+		}
+	}
+
+	void encode_matches_sampling() {
+		std::vector<Material> voxels(PaletteChunk<Material, size>::volume);
+		each({Coord(0), Coord(size - 1)}, [&](const Coord local) {
+			voxels[chunk_index<size>(local)] = vox_test::terrain(local - Coord(3, 7, 5));
+		});
+		check_chunk(PaletteChunk<Material, size>::encode(voxels), voxels);
+
+		const auto uniform = PaletteChunk<Material, size>::encode(std::vector<Material>(voxels.size(), Material{2}));
+		CHECK(uniform.is_uniform());
+		CHECK(uniform[Coord(5)] == Material{2});
+	}
+
+	void cache_round_trip() {
+		auto cache = palette_cache<size>(vox_test::terrain, vox_test::world);
+		int wrong = 0;
+		vox_test::each_around(vox_test::world, [&](const Coord coord) {
+			const Material expected = vox_test::world.contains(coord) ? vox_test::terrain(coord) : Material{};
+			if (!(cache(coord) == expected)) ++wrong;
+		});
+		CHECK(wrong == 0);
+
+		// writes land, including in chunks that were empty and outside the bounds where they are dropped
+		const Coord above(0, vox_test::world.to.y, 0);
+		cache.set(above, Material{9});
+		cache.set(vox_test::world.to + Coord(1), Material{9});
+		CHECK(cache(above) == Material{9});
+		CHECK(cache(vox_test::world.to + Coord(1)) == Material{});
+	}
+}
+
+int main() {
+	grows_on_write();
+	sixteen_bit_indices();
+	overwrites_are_dropped();
+	encode_matches_sampling();
+	cache_round_trip();
+	return vox_test::report();
+}
@@ -0,0 +1,116 @@
+//
+// Region file round trips and the files open() has to refuse
+
+#include "test.h"
+#include <cyrex_voxels/vox/region.h>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+
+using namespace vox;
+using vox_test::Material;
+
+namespace {
+	constexpr int size = 16;
+
+	void round_trip() {
+		const vox_test::TempDirectory directory("cyrex-region");
+		const std::string path = directory.file("world.region");
+
+		for (const unsigned threads : {1u, 3u}) {
+			CHECK(save_region<size>(path, vox_test::terrain, vox_test::world, threads).has_value());
+			const auto region = open_region<Material, size>(path);
+			CHECK(region.has_value());
+			if (!region) return;
+
+			CHECK(region->bounds.from == vox_test::world.from);
+			CHECK(region->bounds.to == vox_test::world.to);
+			int wrong = 0;
+			vox_test::each_around(vox_test::world, [&](const Coord coord) {
+				const Material expected = vox_test::world.contains(coord) ? vox_test::terrain(coord) : Material{};
+				if (!((*region)(coord) == expected)) ++wrong;
+			});
+			CHECK(wrong == 0);
+		}
+	}
+
+	// empty chunks take no payload and uniform ones a single voxel
+	void chunks_are_collapsed() {
+		const vox_test::TempDirectory directory("cyrex-region-chunks");
+		const std::string path = directory.file("world.region");
+		// solid below zero, terrain in the chunk above that and nothing higher up
+		const auto layered = [](const Coord coord) {
+			if (coord.y < 0) return Material{1};
+			return coord.y < size ? vox_test::terrain(coord) : Material{};
+		};
+		CHECK(save_region<size>(path, layered, Bounds{Coord(-size), Coord(2 * size - 1)}, 1).has_value());
+		const auto region = open_region<Material, size>(path);
+		CHECK(region.has_value());
+		if (!region) return;
+
+		CHECK(region->chunk(Coord(0, 1, 0)).empty());
+		CHECK(region->chunk(Coord(0, -1, 0)).size() == 1);
+		CHECK(region->chunk(Coord(0)).size() == static_cast<std::size_t>(size * size * size));
+		// outside the grid altogether
+		CHECK(region->chunk(Coord(100)).empty());
+	}
+
+	// copies share one mapping, which outlives the RegionFile it was opened by
+	void copies_share_the_mapping() {
+		const vox_test::TempDirectory directory("cyrex-region-copies");
+		const std::string path = directory.file("world.region");
+		CHECK(save_region<size>(path, vox_test::terrain, vox_test::world, 1).has_value());
+
+		std::optional<RegionFile<Material, size>> copy;
+		{
+			const auto region = open_region<Material, size>(path);
+			CHECK(region.has_value());
+			if (!region) return;
+			copy = *region;
+			CHECK(copy->chunk(Coord(0)).data() == region->chunk(Coord(0)).data());
+		}
+		int wrong = 0;
+		each(vox_test::world, [&](const Coord coord) {
+			if (!((*copy)(coord) == vox_test::terrain(coord))) ++wrong;
+		});
+		CHECK(wrong == 0);
+	}
+
+	void refuses_bad_files() {
+		const vox_test::TempDirectory directory("cyrex-region-bad");
+		const std::string path = directory.file("world.region");
+
+		const auto missing = open_region<Material, size>(directory.file("missing.region"));
+		CHECK(!missing.has_value() && missing.error().code != 0);
+
+		CHECK(save_region<size>(path, vox_test::terrain, vox_test::world, 1).has_value());
+		CHECK(!open_region<Material, 32>(path).has_value());
+		CHECK(!open_region<std::uint32_t, size>(path).has_value());
+
+		const auto length = std::filesystem::file_size(path);
+		std::filesystem::resize_file(path, length / 2);
+		const auto truncated = open_region<Material, size>(path);
+		CHECK(!truncated.has_value() && truncated.error().code == 0);
+
+		std::ofstream(path, std::ios::binary | std::ios::trunc) << "definitely not a region file, just some text";
+		CHECK(!open_region<Material, size>(path).has_value());
+	}
+
+	// a failed save leaves the file that was there untouched
+	void failed_save_keeps_old_file() {
+		const vox_test::TempDirectory directory("cyrex-region-keep");
+		const std::string path = directory.file("world.region");
+		CHECK(save_region<size>(path, vox_test::terrain, vox_test::world, 1).has_value());
+		CHECK(!save_region<size>(directory.file("missing/world.region"), vox_test::terrain, vox_test::world, 1).has_value());
+		CHECK(open_region<Material, size>(path).has_value());
+	}
+}
+
+int main() {
+	round_trip();
+	chunks_are_collapsed();
+	copies_share_the_mapping();
+	refuses_bad_files();
+	failed_save_keeps_old_file();
+	return vox_test::report();
+}
@@ -0,0 +1,57 @@
+//
+// ColumnRle round trips
+
+#include "test.h"
+#include <cyrex_voxels/vox/rle.h>
+
+using namespace vox;
+using vox_test::Material;
+
+namespace {
+	void cache_round_trip() {
+		const auto cache = column_rle_cache(vox_test::terrain, vox_test::world);
+		int wrong = 0;
+		vox_test::each_around(vox_test::world, [&](const Coord coord) {
+			const Material expected = vox_test::world.contains(coord) ? vox_test::terrain(coord) : Material{};
+			if (!(cache(coord) == expected)) ++wrong;
+		});
+		CHECK(wrong == 0);
+	}
+
+	// runs cover each column exactly once, bottom to top, and neighbouring runs differ
+	void runs_tile_columns() {
+		const auto cache = column_rle_cache(vox_test::terrain, vox_test::world);
+		int wrong = 0;
+		for (int z = vox_test::world.from.z; z <= vox_test::world.to.z; ++z) {
+			for (int x = vox_test::world.from.x; x <= vox_test::world.to.x; ++x) {
+				int next = vox_test::world.from.y;
+				std::optional<Material> previous;
+				cache.each_run(x, z, [&](const int from, const int to, const Material voxel) {
+					if (from != next || to < from || previous == voxel) ++wrong;
+					for (int y = from; y <= to; ++y) {
+						if (!(vox_test::terrain(Coord(x, y, z)) == voxel)) ++wrong;
+					}
+					next = to + 1;
+					previous = voxel;
+				});
+				if (next != vox_test::world.to.y + 1) ++wrong;
+			}
+		}
+		CHECK(wrong == 0);
+	}
+
+	void single_voxel_bounds() {
+		const Bounds one{Coord(-3, 7, 2), Coord(-3, 7, 2)};
+		const auto cache = column_rle_cache([](Coord) { return Material{4}; }, one);
+		CHECK(cache(one.from) == Material{4});
+		CHECK(cache(one.from + Coord(0, 1, 0)) == Material{});
+		CHECK(cache.runs.size() == 1);
+	}
+}
+
+int main() {
+	cache_round_trip();
+	runs_tile_columns();
+	single_voxel_bounds();
+	return vox_test::report();
+}
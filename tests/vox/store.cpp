@@ -0,0 +1,132 @@
+//
+// ChunkStore snapshots, copy-on-write chunks and the dirty sets EditBatch reports
+
+#include "test.h"
+#include <cyrex_voxels/vox/store.h>
+#include <algorithm>
+#include <array>
+#include <set>
+#include <vector>
+
+using namespace vox;
+using vox_test::Material;
+
+namespace {
+	constexpr int size = 16;
+	using Store = ChunkStore<Material, size>;
+
+	// every chunk where the two views differ somewhere inside the bounds, sorted z, y, x
+	[[nodiscard]] std::vector<Coord> changed_chunks(const auto& before, const auto& after) {
+		std::vector<Coord> changed;
+		each_chunk<size>(vox_test::world, [&](const Coord chunk) {
+			bool differs = false;
+			each(store_detail::intersect(chunk_bounds<size>(chunk), vox_test::world), [&](const Coord coord) {
+				differs = differs || !(before(coord) == after(coord));
+			});
+			if (differs) changed.push_back(chunk);
+		});
+		std::ranges::sort(changed, store_detail::chunk_less);
+		return changed;
+	}
+
+	void dirty_sets_are_exact() {
+		Store store(vox_test::terrain, vox_test::world, 1);
+		const auto before = store.snapshot();
+
+		Store::Batch batch;
+		batch.fill(Coord(5, 2, 5), 9.0f, Material{5});
+		batch.fill(Bounds{Coord(-21, -13, -18), Coord(-5, -7, 0)}, Material{6});
+		// rewrites what is already there, so it must not dirty anything on its own
+		batch.fill(Bounds{Coord(30, -13, 30), Coord(40, -8, 37)}, Material{1});
+		batch.apply([](const Coord coord) { return coord.x % 2 ? Material{8} : Material{}; }, Bounds{Coord(20, 10, 20), Coord(26, 12, 22)});
+		batch.set(Coord(44, 19, 37), Material{9});
+		// outside the bounds, ignored
+		batch.set(Coord(100, 0, 0), Material{9});
+		batch.fill(Bounds{Coord(60), Coord(70)}, Material{9});
+
+		const std::vector<Coord> dirty = store.apply(batch, 2);
+		CHECK(dirty == changed_chunks(before, store));
+		CHECK(std::ranges::is_sorted(dirty, store_detail::chunk_less));
+		for (const Coord chunk : dirty) CHECK(store.pending().contains(chunk));
+
+		// the snapshot taken before the edits still sees the world as it was
+		int stale = 0;
+		vox_test::each_around(vox_test::world, [&](const Coord coord) {
+			const Material expected = vox_test::world.contains(coord) ? vox_test::terrain(coord) : Material{};
+			if (!(before(coord) == expected)) ++stale;
+		});
+		CHECK(stale == 0);
+
+		// the same batch again changes nothing
+		CHECK(store.apply(batch, 2).empty());
+
+		store.publish();
+		CHECK(store.pending().empty());
+		CHECK(store.snapshot().version() == before.version() + 1);
+
+		// each_changed_chunk visits the chunks a publish actually changed
+		std::set<std::array<int, 3>> reported;
+		Store::each_changed_chunk(before, store.snapshot(), [&](const Coord chunk, const Store::Chunk*, const Store::Chunk*) {
+			reported.insert({chunk.x, chunk.y, chunk.z});
+		});
+		for (const Coord chunk : dirty) CHECK(reported.contains({chunk.x, chunk.y, chunk.z}));
+	}
+
+	// a chunk edited and then put back is neither dirty nor different
+	void undone_edits_are_clean() {
+		Store store(vox_test::terrain, vox_test::world, 1);
+		const Coord coord(3, 0, 3);
+		const Material original = store(coord);
+
+		Store::Batch batch;
+		batch.set(coord, Material{42});
+		batch.set(coord, original);
+		CHECK(store.apply(batch, 1).empty());
+		CHECK(store(coord) == original);
+	}
+
+	// set() copies a published chunk once and edits it in place after that, without touching snapshots
+	void set_copies_on_write() {
+		Store store(vox_test::terrain, vox_test::world, 1);
+		const auto before = store.snapshot();
+		const Coord chunk = chunk_coord<size>(Coord(0));
+
+		store.set(Coord(0), Material{11});
+		store.publish();
+		CHECK(store.snapshot().chunk(chunk) != before.chunk(chunk));
+		CHECK(before(Coord(0)) == vox_test::terrain(Coord(0)));
+		CHECK(store.snapshot()(Coord(0)) == Material{11});
+
+		const auto published = store.snapshot();
+		store.set(Coord(1), Material{12});
+		store.set(Coord(2), Material{13});
+		CHECK(published(Coord(1)) == vox_test::terrain(Coord(1)));
+		CHECK(store(Coord(2)) == Material{13});
+		CHECK(store.pending().size() == 1);
+	}
+
+	// a snapshot keeps seeing the world it was taken from, whatever is published after it
+	void snapshots_do_not_move() {
+		Store store(vox_test::terrain, vox_test::world, 3);
+		const auto before = store.snapshot();
+		each(vox_test::world, [&](const Coord coord) { store.set(coord, Material{7}); });
+		store.publish();
+
+		int stale = 0;
+		vox_test::each_around(vox_test::world, [&](const Coord coord) {
+			const Material expected = vox_test::world.contains(coord) ? vox_test::terrain(coord) : Material{};
+			if (!(before(coord) == expected)) ++stale;
+			if (!(store.snapshot()(coord) == (vox_test::world.contains(coord) ? Material{7} : Material{}))) ++stale;
+		});
+		CHECK(stale == 0);
+		CHECK(store.snapshot().version() == before.version() + 1);
+	}
+}
+
+int main() {
+	dirty_sets_are_exact();
+	undone_edits_are_clean();
+	set_copies_on_write();
+	snapshots_do_not_move();
+	return vox_test::report();
+}
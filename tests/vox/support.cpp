@@ -0,0 +1,113 @@
+//
+// Soundness of what samplers claim about themselves: nothing outside support() is ever non empty,
+// declared invariant axes really are ignored, and row and slice sampling give the per voxel result
+
+#include "test.h"
+#include <cyrex_voxels/vox/samplers.h>
+#include <cyrex_voxels/vox/transform.h>
+#include <memory>
+#include <string>
+
+using namespace vox;
+using vox_test::Material;
+
+namespace {
+	// wide enough that rows run past row_block and slices past slice_block
+	const Bounds window{Coord(-70, -14, -9), Coord(75, 13, 8)};
+
+	template<VoxelSampler Sampler>
+	void check_sampler(const char* name, const Sampler& sampler) {
+		using Voxel = std::invoke_result_t<Sampler, Coord>;
+
+		int outside = 0;
+		if (const auto box = support(sampler)) {
+			each(window, [&](const Coord coord) {
+				if (!box->contains(coord) && !(sampler(coord) == Voxel{})) ++outside;
+			});
+		}
+		vox_test::check(outside == 0, (std::string(name) + " is empty outside its support").c_str(), __FILE__, __LINE__);
+
+		int variant = 0;
+		constexpr Axes invariant = invariant_axes<Sampler>();
+		each(window, [&](const Coord coord) {
+			const Voxel voxel = sampler(coord);
+			if (invariant.x && !(sampler(coord + Coord(37, 0, 0)) == voxel)) ++variant;
+			if (invariant.y && !(sampler(coord + Coord(0, -23, 0)) == voxel)) ++variant;
+			if (invariant.z && !(sampler(coord + Coord(0, 0, 11)) == voxel)) ++variant;
+		});
+		vox_test::check(variant == 0, (std::string(name) + " ignores its invariant axes").c_str(), __FILE__, __LINE__);
+
+		int rows = 0;
+		sample_each(window, sampler, [&](const Coord coord, const Voxel voxel) {
+			if (!(sampler(coord) == voxel)) ++rows;
+		});
+		const int width = window.size().x;
+		const std::size_t area = static_cast<std::size_t>(width) * window.size().y;
+		const auto slice = std::make_unique<Voxel[]>(area);
+		sample_slice(sampler, window.from, width, std::span(slice.get(), area));
+		each({window.from, Coord(window.to.x, window.to.y, window.from.z)}, [&](const Coord coord) {
+			const Coord local = coord - window.from;
+			if (!(slice[local.x + static_cast<std::size_t>(width) * local.y] == sampler(coord))) ++rows;
+		});
+		vox_test::check(rows == 0, (std::string(name) + " samples rows and slices like single voxels").c_str(), __FILE__, __LINE__);
+	}
+
+	constexpr auto noise = [](const Coord coord) {
+		return ((coord.x * 7 ^ coord.y * 13 ^ coord.z * 5) & 7) == 0;
+	};
+
+	constexpr auto height = [](const Coord coord) {
+		return static_cast<float>((coord.x * coord.x + coord.z * 5) % 9) - 4.0f;
+	};
+}
+
+int main() {
+	using namespace bool_ops;
+
+	const auto ball = sphere(Coord(3, -2, 1), 6.5f);
+	const auto can = cylinder(Coord(-40, -5, 2), 4.0f, 9);
+	const auto crate = box(Bounds{Coord(20, -3, -4), Coord(66, 2, 3)});
+	const auto painted = sphere(Coord(-2), 5.0f, bool_to_voxel(Material{2}, Material{}));
+	// false is not empty, so these know nothing about where they end
+	const auto inverted = cylinder(Coord(), 4.0f, 4, bool_to_voxel(Material{3}, Material{1}));
+	const auto solid = box(Bounds{Coord(-5), Coord(5)}, bool_to_voxel(Material{3}, Material{1}));
+
+	check_sampler("sphere", ball);
+	check_sampler("cylinder", can);
+	check_sampler("box", crate);
+	check_sampler("painted sphere", painted);
+	check_sampler("cylinder with a non empty outside", inverted);
+	check_sampler("box with a non empty outside", solid);
+	CHECK(!support(inverted).has_value());
+	CHECK(!support(solid).has_value());
+
+	check_sampler("and", ball && crate);
+	check_sampler("or", ball || can);
+	check_sampler("xor", can ^ crate);
+	check_sampler("not", !ball);
+	check_sampler("and with noise", noise && (ball || crate));
+	check_sampler("or with noise", noise || crate);
+	check_sampler("and chain", logical<std::logical_and<>>{} << ball << crate << noise);
+	check_sampler("or chain", logical<std::logical_or<>>{} << ball << can);
+
+	const auto ground = columns(xz_only(height), [](const float top, const Coord coord) { return coord.y <= top; });
+	const auto layers = y_only([](const Coord coord) { return coord.y % 3 == 0; });
+	check_sampler("columns", ground);
+	check_sampler("y only", layers);
+	check_sampler("columns and layers", ground && layers);
+	check_sampler("carve", carve(ground, ball));
+	check_sampler("carve with noise", carve(painted, noise));
+	check_sampler("carve a box", carve(crate, can || ball));
+
+	const auto moved = transform() << translate(Coord(17, -3, 2)) << ball;
+	const auto grown = transform() << scale(glm::vec3(1.7f, 0.6f, 2.2f)) << crate;
+	const auto turned = transform() << rotate(glm::angleAxis(0.7f, glm::vec3(0.0f, 1.0f, 0.0f))) << crate;
+	const auto tiled = transform() << repeat(Coord(16)) << translate(Coord(-8)) << ball;
+	check_sampler("translate", moved);
+	check_sampler("scale", grown);
+	check_sampler("rotate", turned);
+	check_sampler("repeat", tiled);
+	CHECK(!support(tiled).has_value());
+
+	return vox_test::report();
+}
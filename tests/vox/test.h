@@ -0,0 +1,93 @@
+//
+// Shared pieces of the vox tests: a CHECK that survives release builds and a small test world
+
+#ifndef CYREX_VOXELS_TEST_H
+#define CYREX_VOXELS_TEST_H
+
+#include <cyrex_voxels/vox/voxel.h>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+namespace vox_test {
+	inline int failures = 0;
+
+	inline void check(const bool passed, const char* expression, const char* file, const int line) {
+		if (passed) return;
+		++failures;
+		std::cerr << file << ":" << line << ": check failed: " << expression << "\n";
+	}
+
+	// The exit code of a test executable
+	[[nodiscard]] inline int report() {
+		if (failures != 0) std::cerr << failures << " check(s) failed\n";
+		return failures == 0 ? 0 : 1;
+	}
+
+	// A voxel with no mesh traits of its own, like most games would use
+	struct Material {
+		std::uint8_t id{};
+		[[nodiscard]] constexpr bool operator==(const Material&) const = default;
+	};
+
+	// Ground with a few layers, bumps along x and z and some pillars, so chunks come out empty,
+	// uniform and mixed. Not aligned to any chunk size and reaching below zero on every axis.
+	inline const vox::Bounds world{vox::Coord(-21, -13, -18), vox::Coord(44, 19, 37)};
+
+	[[nodiscard]] constexpr Material terrain(const vox::Coord coord) {
+		if (coord.y < -6) return {1};
+		if (coord.y < (coord.x * coord.x + 3 * coord.z) % 7 - 2) return {2};
+		if ((coord.x ^ coord.z) % 11 == 0 && coord.y < 9) return {3};
+		return {};
+	}
+
+	// Calls fn(coord) for every voxel of the world and one voxel of margin around it
+	void each_around(const vox::Bounds& bounds, auto fn) {
+		vox::each({bounds.from - vox::Coord(1), bounds.to + vox::Coord(1)}, fn);
+	}
+
+	// A fresh directory for files written by one test, removed when it goes out of scope.
+	// create_directory only succeeds for the caller that made it, so concurrent runs never share one.
+	class TempDirectory {
+	public:
+		explicit TempDirectory(const std::string& name) : path(fresh(name)) {}
+
+		~TempDirectory() {
+			std::error_code ignored;
+			std::filesystem::remove_all(path, ignored);
+		}
+
+		[[nodiscard]] std::string file(const std::string& name) const {
+			return (path / name).string();
+		}
+
+		TempDirectory(const TempDirectory&) = delete;
+		TempDirectory& operator =(const TempDirectory&) = delete;
+	private:
+		std::filesystem::path path;
+
+		[[nodiscard]] static std::filesystem::path fresh(const std::string& name) {
+			const auto base = std::filesystem::temp_directory_path();
+			for (int attempt = 0;; ++attempt) {
+				auto candidate = base / (name + "-" + std::to_string(attempt));
+				if (std::filesystem::create_directory(candidate)) return candidate;
+			}
+		}
+	};
+}
+
+template<>
+struct vox::voxel_mesh_traits<vox_test::Material> {
+	[[nodiscard]] static constexpr bool is_visible(const vox_test::Material material) {
+		return material.id != 0;
+	}
+
+	[[nodiscard]] static constexpr Color color(const vox_test::Material material, Coord) {
+		return Color(material.id / 3.0f, 0.5f, 0.5f, 1.0f);
+	}
+};
+
+#define CHECK(...) vox_test::check(static_cast<bool>(__VA_ARGS__), #__VA_ARGS__, __FILE__, __LINE__)
+
+#endif //CYREX_VOXELS_TEST_H